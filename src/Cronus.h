@@ -4,10 +4,13 @@
 #include "port.h"
 
 #include "core/cronusrun.h"
+#include "core/gc.h"
 
+#include "objects/abstract.h"
 #include "objects/baseobject.h"
 #include "objects/intobject.h"
 #include "objects/stringobject.h"
 #include "objects/floatobject.h"
 #include "objects/listobject.h"
-#include "objects/boolobject.h"
\ No newline at end of file
+#include "objects/boolobject.h"
+#include "objects/dictobject.h"
\ No newline at end of file
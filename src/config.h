@@ -10,6 +10,10 @@
 #	define Cr_ARDUINO_DEBUG
 #endif
 
+/* Define Cr_TAGGED_INTS to store ints inside the object pointer instead of
+   allocating them, see objects/object.h */
+/* #define Cr_TAGGED_INTS */
+
 #define Cr_EXIT_SUCCESS			0U
 #define Cr_EXIT_FAILURE			1U
 
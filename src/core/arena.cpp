@@ -1,5 +1,15 @@
 #include "arena.h"
 
+#include <atomic>
+
+#ifdef MS_WINDOWS
+#   define WIN32_LEAN_AND_MEAN
+#   define NOMINMAX
+#   include <windows.h>
+#else
+#   include <sys/mman.h>
+#endif
+
 #include <core/error.h>
 #include <core/mem.h>
 #include <objects/listobject.h>
@@ -14,6 +24,12 @@
 #define DEFAULT_BLOCK_SIZE	8192
 #define ALIGNMENT			8
 
+/* Mapped arenas (see CrArena_NewLarge()) reserve address space up front
+   and commit it MAP_COMMIT_SIZE bytes at a time. The commit size is the
+   size of a transparent huge page so every commit can be backed by one. */
+#define MAP_COMMIT_SIZE		(2 * 1024 * 1024)
+#define MAP_DEFAULT_RESERVE	(256 * 1024 * 1024)
+
 typedef struct _block
 {
     /* Total number of bytes owned by this block available to pass out.
@@ -65,27 +81,121 @@ typedef struct _arena
     */
     CrObject* a_objects;
 
-#ifdef Cr_DEBUG
-    /* Debug output */
-    size_t total_allocs;
-    size_t total_size;
-    size_t total_blocks;
-    size_t total_block_size;
-    size_t total_big_blocks;
-#endif
+    /* For mapped arenas, the reserved address range. a_head lives at the
+       start of it and its ab_size grows as more of the range is
+       committed. a_map is NULL for ordinary arenas. */
+    void* a_map;
+    size_t a_map_reserved;
+    size_t a_map_committed;
+
+    /* Allocation statistics since the arena was created or last reset */
+    CrArenaStats a_stats;
 };
 
-static block* block_new(size_t size)
+/* Process-wide totals. Every arena folds its statistics in here when it
+   is reset or freed. */
+static struct
+{
+    std::atomic<size_t> arenas;
+    std::atomic<size_t> total_allocs;
+    std::atomic<size_t> total_size;
+    std::atomic<size_t> total_blocks;
+    std::atomic<size_t> total_block_size;
+    std::atomic<size_t> total_big_blocks;
+    std::atomic<size_t> total_waste;
+    std::atomic<size_t> total_objects;
+} global_stats;
+
+static void arena_stats_init(CrArena* arena)
+{
+    CrArenaStats* stats = &arena->a_stats;
+    stats->arenas = 1;
+    stats->total_allocs = 0;
+    stats->total_size = 0;
+    stats->total_blocks = 1;
+    stats->total_block_size = arena->a_head->ab_size;
+    stats->total_big_blocks = 0;
+    stats->total_waste = 0;
+    stats->total_objects = 0;
+}
+
+static void arena_stats_fold(CrArena* arena)
+{
+    CrArenaStats stats;
+    CrArena_GetStats(arena, &stats);
+
+    global_stats.arenas += 1;
+    global_stats.total_allocs += stats.total_allocs;
+    global_stats.total_size += stats.total_size;
+    global_stats.total_blocks += stats.total_blocks;
+    global_stats.total_block_size += stats.total_block_size;
+    global_stats.total_big_blocks += stats.total_big_blocks;
+    global_stats.total_waste += stats.total_waste;
+    global_stats.total_objects += stats.total_objects;
+}
+
+/* A process-wide cache of released DEFAULT_BLOCK_SIZE blocks.
+
+   Arenas are created and destroyed for every statement parsed, so
+   instead of returning their blocks to the system allocator they are
+   parked here for the next arena. The cache is a fixed array of slots
+   which are filled and emptied with atomic operations only; a slot is
+   either empty or owns exactly one block, so there is no locking and no
+   ABA problem.
+*/
+
+#define BLOCK_CACHE_SIZE    32
+
+static std::atomic<block*> block_cache[BLOCK_CACHE_SIZE];
+
+static block* block_cache_pop()
+{
+    for (int i = 0; i < BLOCK_CACHE_SIZE; i++)
+    {
+        if (block_cache[i].load(std::memory_order_relaxed) == NULL)
+            continue;
+        block* b = block_cache[i].exchange(NULL, std::memory_order_acquire);
+        if (b != NULL)
+            return b;
+    }
+    return NULL;
+}
+
+static int block_cache_push(block* b)
+{
+    for (int i = 0; i < BLOCK_CACHE_SIZE; i++)
+    {
+        block* expected = NULL;
+        if (block_cache[i].compare_exchange_strong(expected, b,
+            std::memory_order_release, std::memory_order_relaxed))
+            return 1;
+    }
+    return 0;
+}
+
+static void block_reset(block* b)
 {
-    /* Allocate header and block as one unit.
-       ab_mem points just past header. */
-    block* b = (block*)Mem_Alloc(sizeof(block) + size);
-    if (!b)
-        return NULL;
-    b->ab_size = size;
-    b->ab_mem = (void*)(b + 1);
     b->ab_next = NULL;
     b->ab_offset = (char*)Cr_ALIGN_UP(b->ab_mem, ALIGNMENT) - (char*)(b->ab_mem);
+}
+
+static block* block_new(size_t size)
+{
+    block* b = NULL;
+    if (size == DEFAULT_BLOCK_SIZE)
+        b = block_cache_pop();
+
+    if (!b)
+    {
+        /* Allocate header and block as one unit.
+           ab_mem points just past header. */
+        b = (block*)Mem_Alloc(sizeof(block) + size);
+        if (!b)
+            return NULL;
+        b->ab_size = size;
+        b->ab_mem = (void*)(b + 1);
+    }
+    block_reset(b);
     return b;
 }
 
@@ -94,7 +204,8 @@ static void block_free(block* b)
     while (b)
     {
         block* next = b->ab_next;
-        Mem_Free(b);
+        if (b->ab_size != DEFAULT_BLOCK_SIZE || !block_cache_push(b))
+            Mem_Free(b);
         b = next;
     }
 }
@@ -108,8 +219,8 @@ static void* block_alloc(block* b, size_t size)
     {
         /* If we need to allocate more memory than will fit in
            the default block, allocate a one-off block that is
-           exactly the right size. */
-           /* TODO:Think about space waste at end of block */
+           exactly the right size. The unused tail of the old block
+           is accounted for as waste in the arena statistics. */
         block* newbl = block_new(
             size < DEFAULT_BLOCK_SIZE ?
             DEFAULT_BLOCK_SIZE : size);
@@ -126,6 +237,74 @@ static void* block_alloc(block* b, size_t size)
     return p;
 }
 
+/* Virtual memory helpers for mapped arenas */
+
+static void* map_reserve(size_t size)
+{
+#ifdef MS_WINDOWS
+    return VirtualAlloc(NULL, size, MEM_RESERVE, PAGE_NOACCESS);
+#else
+    /* Over-reserve so the range can be aligned to a huge page boundary,
+       then give the slack back. */
+    size_t slack = MAP_COMMIT_SIZE;
+    void* p = mmap(NULL, size + slack, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (p == MAP_FAILED)
+        return NULL;
+
+    char* base = (char*)Cr_ALIGN_UP(p, MAP_COMMIT_SIZE);
+    size_t head = base - (char*)p;
+    if (head != 0)
+        munmap(p, head);
+    if (slack - head != 0)
+        munmap(base + size, slack - head);
+
+#ifdef MADV_HUGEPAGE
+    madvise(base, size, MADV_HUGEPAGE);
+#endif
+    return base;
+#endif
+}
+
+static int map_commit(void* p, size_t size)
+{
+#ifdef MS_WINDOWS
+    return VirtualAlloc(p, size, MEM_COMMIT, PAGE_READWRITE) != NULL;
+#else
+    return mprotect(p, size, PROT_READ | PROT_WRITE) == 0;
+#endif
+}
+
+static void map_release(void* p, size_t size)
+{
+#ifdef MS_WINDOWS
+    VirtualFree(p, 0, MEM_RELEASE);
+#else
+    munmap(p, size);
+#endif
+}
+
+/* Commit enough of a mapped arena's range for its head block to hold
+   another 'size' bytes. Returns 0 if the reservation is exhausted, in
+   which case the arena continues with ordinary blocks. */
+static int map_grow(CrArena* arena, size_t size)
+{
+    block* b = arena->a_head;
+    size_t needed = sizeof(block) + b->ab_offset + Cr_SIZE_ROUND_UP(size, ALIGNMENT);
+    if (needed > arena->a_map_reserved)
+        return 0;
+
+    size_t committed = Cr_SIZE_ROUND_UP(needed, MAP_COMMIT_SIZE);
+    if (committed > arena->a_map_reserved)
+        committed = arena->a_map_reserved;
+    if (!map_commit((char*)arena->a_map + arena->a_map_committed, committed - arena->a_map_committed))
+        return 0;
+
+    arena->a_stats.total_block_size += committed - arena->a_map_committed;
+    arena->a_map_committed = committed;
+    b->ab_size = committed - sizeof(block);
+    return 1;
+}
+
 CrArena* CrArena_New()
 {
     CrArena* arena = (CrArena*)Mem_Alloc(sizeof(CrArena));
@@ -137,6 +316,9 @@ CrArena* CrArena_New()
 
     arena->a_head = block_new(DEFAULT_BLOCK_SIZE);
     arena->a_cur = arena->a_head;
+    arena->a_map = NULL;
+    arena->a_map_reserved = 0;
+    arena->a_map_committed = 0;
     if (!arena->a_head)
     {
         Mem_Free((void*)arena);
@@ -151,13 +333,52 @@ CrArena* CrArena_New()
         CrError_NoMemory();
         return NULL;
     }
-#ifdef Cr_DEBUG
-    arena->total_allocs = 0;
-    arena->total_size = 0;
-    arena->total_blocks = 1;
-    arena->total_block_size = DEFAULT_BLOCK_SIZE;
-    arena->total_big_blocks = 0;
-#endif
+    arena_stats_init(arena);
+    return arena;
+}
+
+CrArena* CrArena_NewLarge(size_t reserve)
+{
+    if (reserve == 0)
+        reserve = MAP_DEFAULT_RESERVE;
+    reserve = Cr_SIZE_ROUND_UP(reserve, MAP_COMMIT_SIZE);
+
+    void* map = map_reserve(reserve);
+    if (map == NULL)
+        return CrArena_New();
+    if (!map_commit(map, MAP_COMMIT_SIZE))
+    {
+        map_release(map, reserve);
+        return CrArena_New();
+    }
+
+    /* The head block sits at the start of the mapping */
+    block* head = (block*)map;
+    head->ab_size = MAP_COMMIT_SIZE - sizeof(block);
+    head->ab_mem = (void*)(head + 1);
+    block_reset(head);
+
+    CrArena* arena = (CrArena*)Mem_Alloc(sizeof(CrArena));
+    if (!arena)
+    {
+        map_release(map, reserve);
+        CrError_NoMemory();
+        return NULL;
+    }
+    arena->a_head = head;
+    arena->a_cur = head;
+    arena->a_map = map;
+    arena->a_map_reserved = reserve;
+    arena->a_map_committed = MAP_COMMIT_SIZE;
+    arena->a_objects = CrListObject_New(0);
+    if (!arena->a_objects)
+    {
+        map_release(map, reserve);
+        Mem_Free((void*)arena);
+        CrError_NoMemory();
+        return NULL;
+    }
+    arena_stats_init(arena);
     return arena;
 }
 
@@ -165,13 +386,22 @@ void CrArena_Free(CrArena* arena)
 {
     assert(arena);
 #ifdef Cr_DEBUG
+    CrArenaStats* stats = &arena->a_stats;
     fprintf(stderr,
-        "alloc=%zu size=%zu blocks=%zu block_size=%zu big=%zu objects=%zu\n",
-        arena->total_allocs, arena->total_size, arena->total_blocks,
-        arena->total_block_size, arena->total_big_blocks,
+        "alloc=%zu size=%zu blocks=%zu block_size=%zu big=%zu waste=%zu objects=%zu\n",
+        stats->total_allocs, stats->total_size, stats->total_blocks,
+        stats->total_block_size, stats->total_big_blocks, stats->total_waste,
         CrList_GET_SIZE(arena->a_objects));
 #endif
-    block_free(arena->a_head);
+    arena_stats_fold(arena);
+    if (arena->a_map != NULL)
+    {
+        /* Only the overflow blocks are separate, the rest goes in one call */
+        block_free(arena->a_head->ab_next);
+        map_release(arena->a_map, arena->a_map_reserved);
+    }
+    else
+        block_free(arena->a_head);
     /* This property normally holds, except when the code being compiled
        is sys.getobjects(0), in which case there will be two references.
     assert(arena->a_objects->ob_refcnt == 1);
@@ -181,28 +411,48 @@ void CrArena_Free(CrArena* arena)
     Mem_Free(arena);
 }
 
+void CrArena_Reset(CrArena* arena)
+{
+    assert(arena);
+    arena_stats_fold(arena);
+
+    /* Keep the first block and hand the rest back to the block cache */
+    block_free(arena->a_head->ab_next);
+    block_reset(arena->a_head);
+    arena->a_cur = arena->a_head;
+
+    CrList_Clear(arena->a_objects);
+    arena_stats_init(arena);
+}
+
 void* CrArena_Alloc(CrArena* arena, size_t size)
 {
+    if (arena->a_map != NULL && arena->a_cur == arena->a_head)
+    {
+        block* b = arena->a_head;
+        if (b->ab_offset + Cr_SIZE_ROUND_UP(size, ALIGNMENT) > b->ab_size)
+            map_grow(arena, size);
+    }
+
     void* p = block_alloc(arena->a_cur, size);
     if (!p)
     {
         CrError_NoMemory();
         return NULL;
     }
-#ifdef Cr_DEBUG
-    arena->total_allocs++;
-    arena->total_size += size;
-#endif
+    CrArenaStats* stats = &arena->a_stats;
+    stats->total_allocs++;
+    stats->total_size += size;
+
     /* Reset cur if we allocated a new block. */
     if (arena->a_cur->ab_next)
     {
+        stats->total_waste += arena->a_cur->ab_size - arena->a_cur->ab_offset;
         arena->a_cur = arena->a_cur->ab_next;
-#ifdef Cr_DEBUG
-        arena->total_blocks++;
-        arena->total_block_size += arena->a_cur->ab_size;
+        stats->total_blocks++;
+        stats->total_block_size += arena->a_cur->ab_size;
         if (arena->a_cur->ab_size > DEFAULT_BLOCK_SIZE)
-            ++arena->total_big_blocks;
-#endif
+            ++stats->total_big_blocks;
     }
     return p;
 }
@@ -214,3 +464,32 @@ int CrArena_AddCrObject(CrArena* arena, CrObject* obj)
         CrObject_DECREF(obj);
     return result;
 }
+
+void CrArena_GetStats(CrArena* arena, CrArenaStats* stats)
+{
+    assert(arena);
+    *stats = arena->a_stats;
+    stats->total_objects = CrList_GET_SIZE(arena->a_objects);
+}
+
+void CrArena_GetGlobalStats(CrArenaStats* stats)
+{
+    stats->arenas = global_stats.arenas;
+    stats->total_allocs = global_stats.total_allocs;
+    stats->total_size = global_stats.total_size;
+    stats->total_blocks = global_stats.total_blocks;
+    stats->total_block_size = global_stats.total_block_size;
+    stats->total_big_blocks = global_stats.total_big_blocks;
+    stats->total_waste = global_stats.total_waste;
+    stats->total_objects = global_stats.total_objects;
+}
+
+void CrArena_ClearBlockCache()
+{
+    for (int i = 0; i < BLOCK_CACHE_SIZE; i++)
+    {
+        block* b = block_cache[i].exchange(NULL, std::memory_order_acquire);
+        if (b != NULL)
+            Mem_Free(b);
+    }
+}
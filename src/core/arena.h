@@ -5,9 +5,41 @@
 
 typedef struct _arena CrArena;
 
+typedef struct _arenastats
+{
+	size_t arenas;				// Number of arena lifetimes counted in
+	size_t total_allocs;		// Number of CrArena_Alloc() calls
+	size_t total_size;			// Bytes requested through CrArena_Alloc()
+	size_t total_blocks;		// Blocks used, including the first one
+	size_t total_block_size;	// Bytes reserved by those blocks
+	size_t total_big_blocks;	// One-off blocks larger than the default size
+	size_t total_waste;			// Bytes left unused at the end of abandoned blocks
+	size_t total_objects;		// CrObjects owned by the arena
+} CrArenaStats;
+
 CrArena* CrArena_New();
+
+/* Create an arena for very large inputs. It reserves 'reserve' bytes of
+   address space (a default if 0) and commits it in huge-page sized steps
+   as allocations need it, so allocation stays a pointer bump and freeing
+   is a single unmap. Falls back to CrArena_New() if the platform refuses
+   the reservation. */
+CrArena* CrArena_NewLarge(size_t reserve);
 void CrArena_Free(CrArena* arena);
 
+/* Release everything allocated from the arena but keep its first block,
+   so the arena can be used again without going back to the allocator. */
+void CrArena_Reset(CrArena* arena);
+
 void* CrArena_Alloc(CrArena* arena, size_t size);
 
-int CrArena_AddCrObject(CrArena* arena, CrObject* obj);
\ No newline at end of file
+int CrArena_AddCrObject(CrArena* arena, CrObject* obj);
+
+/* Statistics for a single arena since it was created or last reset */
+void CrArena_GetStats(CrArena* arena, CrArenaStats* stats);
+
+/* Process-wide totals over every arena that has been reset or freed */
+void CrArena_GetGlobalStats(CrArenaStats* stats);
+
+/* Free the blocks parked in the process-wide block cache */
+void CrArena_ClearBlockCache();
\ No newline at end of file
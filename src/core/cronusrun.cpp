@@ -1,6 +1,8 @@
 #include "cronusrun.h"
 
 #include <core/errorcode.h>
+#include <core/gc.h>
+#include <core/hash.h>
 #include <core/lifecycle.h>
 #include <objects/stringobject.h>
 #include <parser/generator.h>
@@ -63,6 +65,8 @@ CrStatus CrRuntime_Initialize()
     if (CrRuntime.initialized)
         return CrStatus_Ok();
 
+    CrHash_Init();
+
     return CrRuntimeState_Init(CrRuntime);
 }
 
@@ -73,17 +77,22 @@ int CrRuntime_Finalize()
 	if (!CrRuntime.initialized)
 		return status;
 
+	CrGC_Collect();
+	CrString_ClearInterned();
+	CrCore_ClearFreeLists();
+	CrArena_ClearBlockCache();
 	CrRuntimeState_Finalize(CrRuntime);
 	return status;
 }
 
 int Cr_FileIsInteractive(std::ifstream* fp, CrObject* filename)
 {
+	if (filename == NULL)
+		return 1;
 	if (CrString_Check(filename))
 	{
-		return (filename == NULL) ||
-			(strcmp(((CrStringObject*)filename)->ob_svar, "<stdin>")) ||
-			(strcmp(((CrStringObject*)filename)->ob_svar, "???"));
+		return (strcmp(((CrStringObject*)filename)->ob_svar, "<stdin>") == 0) ||
+			(strcmp(((CrStringObject*)filename)->ob_svar, "???") == 0);
 	}
 	CrError_SetString(CrExc_SystemError, "Bad internal call");
 	return -1;
@@ -141,12 +150,11 @@ int CrRun_FileObject(std::ifstream* fp, CrObject* filename, bool close)
 	return result;
 }
 
-int CrRun_InteractiveObject(std::ifstream* fp, CrObject* filename)
+static int run_interactive_one(std::ifstream* fp, CrObject* filename, CrArena* arena)
 {
 	const char* ps1 = NULL, * ps2 = NULL;
 	int error_code = 0;
 	mod_type mod;
-	CrArena* arena;
 
 	if (Cr_FileIsInteractive(fp, filename))
 	{
@@ -154,14 +162,9 @@ int CrRun_InteractiveObject(std::ifstream* fp, CrObject* filename)
 		ps2 = "... ";
 	}
 
-	arena = CrArena_New();
-	if (arena == NULL)
-		return -1;
-
 	mod = CrGen_ASTFromFileObject(fp, filename, PARSER_MODE_SINGLE_INPUT, ps1, ps2, &error_code, arena);
 	if (mod == NULL)
 	{
-		CrArena_Free(arena);
 		if (error_code == E_EOF)
 		{
 			CrError_Clear();
@@ -170,27 +173,67 @@ int CrRun_InteractiveObject(std::ifstream* fp, CrObject* filename)
 		return -1;
 	}
 
-	CrArena_Free(arena);
 	return 0;
 }
 
+int CrRun_InteractiveObject(std::ifstream* fp, CrObject* filename)
+{
+	CrArena* arena = CrArena_New();
+	if (arena == NULL)
+		return -1;
+
+	int result = run_interactive_one(fp, filename, arena);
+	CrArena_Free(arena);
+	return result;
+}
+
 int CrRun_InteractiveLoop(std::ifstream* fp, CrObject* filename)
 {
 	int error = 0;
 	int ret = 0;
+
+	// One arena serves every statement, it is rewound after each one
+	CrArena* arena = CrArena_New();
+	if (arena == NULL)
+		return -1;
+
 	do
 	{
-		ret = CrRun_InteractiveObject(fp, filename);
+		ret = run_interactive_one(fp, filename, arena);
+		CrArena_Reset(arena);
 		if (ret == -1 && CrError_Occurred())
 		{
 			CrError_Print();
 		}
 	} while (ret != E_EOF);
+
+	CrArena_Free(arena);
 	return error;
 }
 
 int CrRun_SimpleFileObject(std::ifstream* fp, CrObject* filename, bool close)
 {
-	// Currently not supported
-	return -1;
+	int error_code = 0;
+
+	// The whole file becomes one AST, so use an arena that grows in place
+	CrArena* arena = CrArena_NewLarge(0);
+	if (arena == NULL)
+	{
+		if (close)
+			fp->close();
+		return -1;
+	}
+
+	mod_type mod = CrGen_ASTFromFileObject(fp, filename, PARSER_MODE_FILE_INPUT, NULL, NULL, &error_code, arena);
+	if (close)
+		fp->close();
+
+	CrArena_Free(arena);
+	if (mod == NULL)
+	{
+		if (CrError_Occurred())
+			CrError_Print();
+		return -1;
+	}
+	return 0;
 }
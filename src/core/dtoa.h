@@ -0,0 +1,27 @@
+#pragma once
+
+#include <port.h>
+
+/*
+ * Conversions between doubles and decimal strings
+ *
+ * Parsing tries Clinger's exact fast path first, then the Eisel-Lemire
+ * algorithm, and only falls back to strtod() for the rare inputs where
+ * neither can decide the rounding. Formatting finds the shortest digit
+ * string that reads back as the same double with Giulietti's Schubfach
+ * algorithm. Both use the same table of 128-bit powers of ten.
+ */
+
+/* Enough for any repr: sign, 17 digits, point, padding zeros and exponent */
+#define Cr_DTOA_BUFSIZE		32
+
+/* Parse a decimal float, with optional sign and exponent, or inf/infinity/
+   nan in any case. *end is set past the last character used, or to 's' if
+   no number was found, in which case 0.0 is returned. Values too large
+   for a double give an infinity. */
+double Cr_StringToDouble(const char* s, const char** end);
+
+/* Write the shortest string that reads back as 'x' into 'buf', which must
+   hold Cr_DTOA_BUFSIZE bytes, and return its length. The format matches
+   Python's repr(): '1.0', '0.001', '1e-05', '1e+16', 'inf', 'nan'. */
+int Cr_DoubleToString(double x, char* buf);
@@ -36,26 +36,25 @@ static void error_clear(CrThreadState* tstate)
 
 static CrObject* error_format_string(CrThreadState* tstate, CrObject* exception, const char* string)
 {
-	if (CrException_Check(exception))
+	if (!CrException_Check(exception))
 		return NULL;
 
-	CrObject* result = NULL;
-	CrObject* str1;
-	CrObject* str2;
+	CrObject* type = ((CrExceptionObject*)exception)->type;
+	if (type == NULL)
+		return NULL;
 
-	str1 = ((CrExceptionObject*)exception)->type;
-	if (str1 == NULL)
+	/* "<type>: <message>" */
+	CrStringBuilder sb;
+	if (CrStringBuilder_Init(&sb, Cr_SIZE(type) + 2 + strlen(string)) < 0)
 		return NULL;
-	str2 = CrStringObject_FromString(string);
-	if (str2 == NULL)
+	if (CrStringBuilder_AppendObject(&sb, type) < 0 ||
+		CrStringBuilder_Append(&sb, ": ", 2) < 0 ||
+		CrStringBuilder_AppendString(&sb, string) < 0)
+	{
+		CrStringBuilder_Dealloc(&sb);
 		return NULL;
-
-	CrObject* sep_str = CrStringObject_FromString(": ");
-
-	result = (CrObject*)CrString_Concat(CrString_Concat(str1, sep_str), str2);
-	CrObject_XDECREF(str1);
-	CrObject_XDECREF(str2);
-	return result;
+	}
+	return CrStringBuilder_Finish(&sb);
 }
 
 static CrObject* error_format(CrThreadState* tstate, CrObject* exception, const char* string)
@@ -75,6 +74,7 @@ static void error_set_object(CrThreadState* tstate, CrObject* exception, CrObjec
 	//	return;
 	//}
 
+	CrObject_XINCREF(exception);
 	CrObject_XINCREF(value);
 	error_restore(tstate, exception, value);
 }
@@ -182,8 +182,19 @@ CrTypeObject CrExceptionType = {
 	TPFLAGS_DEFAULT | TPFLAGS_BASETYPE |	    // tp_flags
 		TPFLAGS_BASE_EXC_SUBCLASS,
 	0,										    // tp_dealloc
+	0,											// tp_hash
+	0,											// tp_as_number
+	0,											// tp_richcompare
+	0,											// tp_iter
+	0,											// tp_iternext
+	0,											// tp_getattro
+	0,											// tp_call
+	0,											// tp_traverse
+	0,											// tp_clear
 	0,											// tp_base
-	Mem_Free								    // tp_free
+	0,											// tp_depth
+	0,											// tp_display
+	Mem_ObjectFree							    // tp_free
 };
 
 CrObject* CrExc_Exception = CrExceptionObject_New("Exception", 1);
@@ -198,4 +209,8 @@ CrObject* CrExc_TabError = CrExceptionObject_New("TabError", 7);
 CrObject* CrExc_KeyboardInterrupt = CrExceptionObject_New("KeyboardInterrupt", 8);
 CrObject* CrExc_MemoryError = CrExceptionObject_New("MemoryError", 9);
 CrObject* CrExc_SystemError = CrExceptionObject_New("SystemError", 10);
-CrObject* CrExc_RuntimeError = CrExceptionObject_New("RuntimeError", 11);
\ No newline at end of file
+CrObject* CrExc_RuntimeError = CrExceptionObject_New("RuntimeError", 11);
+CrObject* CrExc_KeyError = CrExceptionObject_New("KeyError", 12);
+CrObject* CrExc_ZeroDivisionError = CrExceptionObject_New("ZeroDivisionError", 13);
+CrObject* CrExc_OverflowError = CrExceptionObject_New("OverflowError", 14);
+CrObject* CrExc_AttributeError = CrExceptionObject_New("AttributeError", 15);
\ No newline at end of file
@@ -34,7 +34,7 @@ typedef struct _viexceptionobject
 
 CrObject* CrExceptionObject_New(const char* type, int exitcode);
 
-#define CrException_Check(self) CrType_HasFeature((CrTypeObject*)self, TPFLAGS_BASE_EXC_SUBCLASS)
+#define CrException_Check(self) CrType_FastSubClass(Cr_TYPE(self), TPFLAGS_BASE_EXC_SUBCLASS)
 
 /* Predefined exceptions */
 extern CrObject* CrExc_Exception;
@@ -49,4 +49,8 @@ extern CrObject* CrExc_TabError;
 extern CrObject* CrExc_KeyboardInterrupt;
 extern CrObject* CrExc_MemoryError;
 extern CrObject* CrExc_SystemError;
-extern CrObject* CrExc_RuntimeError;
\ No newline at end of file
+extern CrObject* CrExc_RuntimeError;
+extern CrObject* CrExc_KeyError;
+extern CrObject* CrExc_ZeroDivisionError;
+extern CrObject* CrExc_OverflowError;
+extern CrObject* CrExc_AttributeError;
\ No newline at end of file
@@ -0,0 +1,557 @@
+#include "gc.h"
+
+#include <core/error.h>
+
+#include <chrono>
+
+/*
+*
+*		GC lists
+*
+*/
+
+/* gc_space says which list a tracked object is on. The collection spaces
+   are only used while a collection runs: everything being collected starts
+   out COLLECTING, and move_unreachable() sorts it into REACHABLE objects
+   and TENTATIVE ones that nothing outside the set refers to. */
+enum
+{
+	GC_SPACE_UNTRACKED = -1,
+	GC_SPACE_YOUNG,
+	GC_SPACE_AGING,
+	GC_SPACE_OLD_PENDING,		// Old objects not yet scanned in this pass
+	GC_SPACE_OLD_VISITED,		// Old objects scanned in this pass
+	GC_SPACE_COLLECTING,
+	GC_SPACE_REACHABLE,
+	GC_SPACE_TENTATIVE
+};
+
+#define GC_GEN_YOUNG	0
+#define GC_GEN_AGING	1
+#define GC_GEN_OLD		2
+
+#define AS_GC(op)		(((CrGC_Head*)(op)) - 1)
+#define FROM_GC(gc)		((CrObject*)(((CrGC_Head*)(gc)) + 1))
+
+#define GC_LIST_INIT(head, space)	{&head, &head, 0, space}
+
+static CrGC_Head young = GC_LIST_INIT(young, GC_SPACE_YOUNG);
+static CrGC_Head aging = GC_LIST_INIT(aging, GC_SPACE_AGING);
+static CrGC_Head old_pending = GC_LIST_INIT(old_pending, GC_SPACE_OLD_PENDING);
+static CrGC_Head old_visited = GC_LIST_INIT(old_visited, GC_SPACE_OLD_VISITED);
+
+/* Number of objects in each of the four tracked spaces */
+static Cr_size_t space_count[GC_SPACE_OLD_VISITED + 1];
+
+static int enabled = 1;
+static int collecting = 0;
+static int debug = 0;
+
+static int thresholds[CrGC_NUM_GENERATIONS] = { 700, 10, 10 };
+static int young_collections = 0;		// Since the last aging collection
+static int aging_collections = 0;		// Since the last old increment
+static Cr_size_t increment_size = 1000;
+static Cr_size_t promoted = 0;			// Objects promoted since the last increment
+
+static CrGCStats gc_stats;
+
+static inline void gc_list_init(CrGC_Head* list)
+{
+	list->gc_next = list;
+	list->gc_prev = list;
+}
+
+static inline int gc_list_is_empty(CrGC_Head* list)
+{
+	return list->gc_next == list;
+}
+
+static inline void gc_list_append(CrGC_Head* node, CrGC_Head* list)
+{
+	CrGC_Head* last = list->gc_prev;
+	node->gc_prev = last;
+	node->gc_next = list;
+	last->gc_next = node;
+	list->gc_prev = node;
+}
+
+static inline void gc_list_remove(CrGC_Head* node)
+{
+	node->gc_prev->gc_next = node->gc_next;
+	node->gc_next->gc_prev = node->gc_prev;
+	node->gc_next = NULL;
+	node->gc_prev = NULL;
+}
+
+static inline void gc_list_move(CrGC_Head* node, CrGC_Head* list)
+{
+	node->gc_prev->gc_next = node->gc_next;
+	node->gc_next->gc_prev = node->gc_prev;
+	gc_list_append(node, list);
+}
+
+/* Append every node of 'from' to 'to', leaving 'from' empty */
+static void gc_list_merge(CrGC_Head* from, CrGC_Head* to)
+{
+	if (gc_list_is_empty(from))
+		return;
+	CrGC_Head* tail = to->gc_prev;
+	tail->gc_next = from->gc_next;
+	tail->gc_next->gc_prev = tail;
+	to->gc_prev = from->gc_prev;
+	to->gc_prev->gc_next = to;
+	gc_list_init(from);
+}
+
+static Cr_size_t gc_list_set_space(CrGC_Head* list, Cr_size_t space)
+{
+	Cr_size_t n = 0;
+	for (CrGC_Head* gc = list->gc_next; gc != list; gc = gc->gc_next)
+	{
+		gc->gc_space = space;
+		n++;
+	}
+	return n;
+}
+
+static Cr_size_t gc_list_size(CrGC_Head* list)
+{
+	Cr_size_t n = 0;
+	for (CrGC_Head* gc = list->gc_next; gc != list; gc = gc->gc_next)
+		n++;
+	return n;
+}
+
+/* The GC head of 'op' if it is a tracked object in 'space', else NULL */
+static inline CrGC_Head* gc_in_space(CrObject* op, Cr_size_t space)
+{
+	if (!CrObject_IS_GC(op))
+		return NULL;
+	CrGC_Head* gc = AS_GC(op);
+	return gc->gc_space == space ? gc : NULL;
+}
+
+/*
+*
+*		Allocation and tracking
+*
+*/
+
+static void collect_generations();
+
+CrObject* CrObject_GC_New(CrTypeObject* type)
+{
+	assert(type->tp_flags & TPFLAGS_HAVE_GC);
+
+	if (enabled && !collecting && space_count[GC_SPACE_YOUNG] > thresholds[GC_GEN_YOUNG])
+		collect_generations();
+
+	CrGC_Head* gc = (CrGC_Head*)Mem_ObjectAlloc(sizeof(CrGC_Head) + type->tp_size);
+	if (gc == NULL)
+	{
+		CrError_NoMemory();
+		return NULL;
+	}
+	gc->gc_next = NULL;
+	gc->gc_prev = NULL;
+	gc->gc_refs = 0;
+	gc->gc_space = GC_SPACE_UNTRACKED;
+
+	CrObject* op = FROM_GC(gc);
+	ObjectInit(op, type);
+	return op;
+}
+
+void CrObject_GC_Del(void* op)
+{
+	CrGC_Head* gc = AS_GC(op);
+	if (gc->gc_space != GC_SPACE_UNTRACKED)
+		CrObject_GC_UnTrack(op);
+	Mem_ObjectFree(gc);
+}
+
+void CrObject_GC_Track(void* op)
+{
+	CrGC_Head* gc = AS_GC(op);
+	assert(gc->gc_space == GC_SPACE_UNTRACKED);
+	gc->gc_space = GC_SPACE_YOUNG;
+	gc_list_append(gc, &young);
+	space_count[GC_SPACE_YOUNG]++;
+}
+
+void CrObject_GC_UnTrack(void* op)
+{
+	CrGC_Head* gc = AS_GC(op);
+	if (gc->gc_space == GC_SPACE_UNTRACKED)
+		return;
+	if (gc->gc_space <= GC_SPACE_OLD_VISITED)
+		space_count[gc->gc_space]--;
+	gc_list_remove(gc);
+	gc->gc_space = GC_SPACE_UNTRACKED;
+}
+
+int CrObject_GC_IsTracked(CrObject* op)
+{
+	return CrObject_IS_GC(op) && AS_GC(op)->gc_space != GC_SPACE_UNTRACKED;
+}
+
+/*
+*
+*		Collection
+*
+*/
+
+/* Start gc_refs at the reference count. What is left after subtracting
+   the references from inside the set are the references from outside. */
+static void update_refs(CrGC_Head* containers)
+{
+	for (CrGC_Head* gc = containers->gc_next; gc != containers; gc = gc->gc_next)
+		gc->gc_refs = Cr_REFCNT(FROM_GC(gc));
+}
+
+static int visit_decref(CrObject* op, void*)
+{
+	CrGC_Head* gc = gc_in_space(op, GC_SPACE_COLLECTING);
+	if (gc != NULL)
+		gc->gc_refs--;
+	return 0;
+}
+
+static void subtract_refs(CrGC_Head* containers)
+{
+	for (CrGC_Head* gc = containers->gc_next; gc != containers; gc = gc->gc_next)
+	{
+		CrObject* op = FROM_GC(gc);
+		Cr_TYPE(op)->tp_traverse(op, visit_decref, NULL);
+	}
+}
+
+static int visit_reachable(CrObject* op, void* arg)
+{
+	if (!CrObject_IS_GC(op))
+		return 0;
+
+	CrGC_Head* gc = AS_GC(op);
+	if (gc->gc_space == GC_SPACE_COLLECTING)
+	{
+		/* Not scanned yet, make sure it is kept when it is */
+		if (gc->gc_refs == 0)
+			gc->gc_refs = 1;
+	}
+	else if (gc->gc_space == GC_SPACE_TENTATIVE)
+	{
+		/* Looked unreachable, but a reachable object refers to it. Move it
+		   back so the scan in move_unreachable() reaches it again. */
+		gc_list_move(gc, (CrGC_Head*)arg);
+		gc->gc_space = GC_SPACE_COLLECTING;
+		gc->gc_refs = 1;
+	}
+	return 0;
+}
+
+/* Move everything in 'containers' that is only referenced from inside the
+   set to 'unreachable'. Objects with outside references are reachable, and
+   so is everything they refer to, which is why the scan can put an object
+   back after it has already been moved. */
+static void move_unreachable(CrGC_Head* containers, CrGC_Head* unreachable)
+{
+	CrGC_Head* gc = containers->gc_next;
+	while (gc != containers)
+	{
+		CrGC_Head* next;
+		if (gc->gc_refs > 0)
+		{
+			CrObject* op = FROM_GC(gc);
+			gc->gc_space = GC_SPACE_REACHABLE;
+			Cr_TYPE(op)->tp_traverse(op, visit_reachable, containers);
+			next = gc->gc_next;
+		}
+		else
+		{
+			next = gc->gc_next;
+			gc_list_move(gc, unreachable);
+			gc->gc_space = GC_SPACE_TENTATIVE;
+		}
+		gc = next;
+	}
+}
+
+/* Break the cycles in 'unreachable'. Clearing an object drops its
+   references, which frees the rest of its cycle through the normal
+   deallocators. Objects that survive that go to 'survivors' in 'space'. */
+static void delete_garbage(CrGC_Head* unreachable, CrGC_Head* survivors, Cr_size_t space)
+{
+	while (!gc_list_is_empty(unreachable))
+	{
+		CrGC_Head* gc = unreachable->gc_next;
+		CrObject* op = FROM_GC(gc);
+		inquiry clear = Cr_TYPE(op)->tp_clear;
+
+		CrObject_INCREF(op);
+		if (clear != NULL)
+			clear(op);
+		if (unreachable->gc_next == gc)
+		{
+			gc_list_move(gc, survivors);
+			gc->gc_space = space;
+			space_count[space]++;
+		}
+		CrObject_DECREF(op);
+	}
+}
+
+static int visit_add_to_increment(CrObject* op, void* arg)
+{
+	CrGC_Head* gc = gc_in_space(op, GC_SPACE_OLD_PENDING);
+	if (gc != NULL)
+	{
+		gc_list_move(gc, (CrGC_Head*)arg);
+		gc->gc_space = GC_SPACE_COLLECTING;
+		space_count[GC_SPACE_OLD_PENDING]--;
+	}
+	return 0;
+}
+
+/* Collect 'containers' and move the survivors to 'destination'. The
+   objects must already be in GC_SPACE_COLLECTING. */
+static Cr_size_t collect(CrGC_Head* containers, CrGC_Head* destination, Cr_size_t space,
+	int generation)
+{
+	CrGC_Head unreachable;
+	gc_list_init(&unreachable);
+
+	auto start = std::chrono::steady_clock::now();
+	collecting = 1;
+
+	update_refs(containers);
+	subtract_refs(containers);
+	move_unreachable(containers, &unreachable);
+
+	/* Everything left in containers is reachable, put it in place before
+	   running any tp_clear so the lists are consistent while it runs */
+	Cr_size_t reachable = gc_list_set_space(containers, space);
+	space_count[space] += reachable;
+	gc_list_merge(containers, destination);
+
+	Cr_size_t garbage = gc_list_size(&unreachable);
+	Cr_size_t examined = reachable + garbage;
+	Cr_size_t before = space_count[space];
+	delete_garbage(&unreachable, destination, space);
+	Cr_size_t survived = space_count[space] - before;
+
+	collecting = 0;
+	auto elapsed = std::chrono::steady_clock::now() - start;
+	Cr_uint64_t pause = (Cr_uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+
+	Cr_size_t collected = garbage - survived;
+	CrGCGenerationStats* gen = &gc_stats.generations[generation];
+	gen->collections++;
+	gen->collected += collected;
+	gen->examined += examined;
+	gen->total_pause_ns += pause;
+	if (pause > gen->max_pause_ns)
+		gen->max_pause_ns = pause;
+	gc_stats.last_pause_ns = pause;
+
+	if (debug & CrGC_DEBUG_STATS)
+	{
+		fprintf(stderr, "gc: generation %d, %zd examined, %zd collected, %.6fs elapsed\n",
+			generation, examined, collected, pause / 1e9);
+	}
+	return collected;
+}
+
+/* Take the whole of 'list' into the set being collected */
+static void take_list(CrGC_Head* list, CrGC_Head* containers)
+{
+	gc_list_set_space(list, GC_SPACE_COLLECTING);
+	gc_list_merge(list, containers);
+	space_count[list->gc_space] = 0;
+}
+
+/* Once every old object has been scanned, start the next pass */
+static void finish_pass()
+{
+	if (!gc_list_is_empty(&old_pending))
+		return;
+	gc_list_set_space(&old_visited, GC_SPACE_OLD_PENDING);
+	gc_list_merge(&old_visited, &old_pending);
+	space_count[GC_SPACE_OLD_PENDING] = space_count[GC_SPACE_OLD_VISITED];
+	space_count[GC_SPACE_OLD_VISITED] = 0;
+	gc_stats.full_passes++;
+}
+
+static void collect_young()
+{
+	CrGC_Head containers;
+	gc_list_init(&containers);
+	take_list(&young, &containers);
+	collect(&containers, &aging, GC_SPACE_AGING, GC_GEN_YOUNG);
+}
+
+static Cr_size_t promote(CrGC_Head* containers, int generation)
+{
+	Cr_size_t before = space_count[GC_SPACE_OLD_VISITED];
+	Cr_size_t collected = collect(containers, &old_visited, GC_SPACE_OLD_VISITED, generation);
+	promoted += space_count[GC_SPACE_OLD_VISITED] - before;
+	return collected;
+}
+
+static void collect_aging()
+{
+	CrGC_Head containers;
+	gc_list_init(&containers);
+	take_list(&young, &containers);
+	take_list(&aging, &containers);
+	promote(&containers, GC_GEN_AGING);
+}
+
+/* Collect the young objects together with a slice of the old generation,
+   plus every pending old object the slice refers to. Cycles that cross
+   into objects already visited in this pass are found in the next one. */
+static void collect_increment()
+{
+	CrGC_Head containers;
+	gc_list_init(&containers);
+	take_list(&young, &containers);
+	take_list(&aging, &containers);
+
+	Cr_size_t budget = increment_size + 2 * promoted;
+	promoted = 0;
+	while (budget-- > 0 && !gc_list_is_empty(&old_pending))
+	{
+		CrGC_Head* gc = old_pending.gc_next;
+		gc_list_move(gc, &containers);
+		gc->gc_space = GC_SPACE_COLLECTING;
+		space_count[GC_SPACE_OLD_PENDING]--;
+	}
+
+	for (CrGC_Head* gc = containers.gc_next; gc != &containers; gc = gc->gc_next)
+	{
+		CrObject* op = FROM_GC(gc);
+		Cr_TYPE(op)->tp_traverse(op, visit_add_to_increment, &containers);
+	}
+
+	promote(&containers, GC_GEN_OLD);
+	promoted = 0;
+	finish_pass();
+}
+
+static void collect_generations()
+{
+	if (++young_collections < thresholds[GC_GEN_AGING])
+	{
+		collect_young();
+		return;
+	}
+	young_collections = 0;
+
+	if (++aging_collections < thresholds[GC_GEN_OLD])
+	{
+		collect_aging();
+		return;
+	}
+	aging_collections = 0;
+	collect_increment();
+}
+
+Cr_size_t CrGC_Collect()
+{
+	if (collecting)
+		return 0;
+
+	CrGC_Head containers;
+	gc_list_init(&containers);
+	take_list(&young, &containers);
+	take_list(&aging, &containers);
+	take_list(&old_pending, &containers);
+	take_list(&old_visited, &containers);
+	young_collections = 0;
+	aging_collections = 0;
+	promoted = 0;
+
+	Cr_size_t collected = collect(&containers, &old_visited, GC_SPACE_OLD_VISITED, GC_GEN_OLD);
+	finish_pass();
+	return collected;
+}
+
+/*
+*
+*		Control and statistics
+*
+*/
+
+void CrGC_Enable()
+{
+	enabled = 1;
+}
+
+void CrGC_Disable()
+{
+	enabled = 0;
+}
+
+int CrGC_IsEnabled()
+{
+	return enabled;
+}
+
+void CrGC_SetThreshold(int threshold0, int threshold1, int threshold2)
+{
+	thresholds[GC_GEN_YOUNG] = threshold0;
+	thresholds[GC_GEN_AGING] = threshold1;
+	thresholds[GC_GEN_OLD] = threshold2;
+}
+
+void CrGC_GetThreshold(int* threshold0, int* threshold1, int* threshold2)
+{
+	*threshold0 = thresholds[GC_GEN_YOUNG];
+	*threshold1 = thresholds[GC_GEN_AGING];
+	*threshold2 = thresholds[GC_GEN_OLD];
+}
+
+void CrGC_SetIncrementSize(Cr_size_t size)
+{
+	increment_size = size < 1 ? 1 : size;
+}
+
+void CrGC_SetDebug(int flags)
+{
+	debug = flags;
+}
+
+int CrGC_GetDebug()
+{
+	return debug;
+}
+
+void CrGC_GetStats(CrGCStats* stats)
+{
+	*stats = gc_stats;
+	stats->tracked[GC_GEN_YOUNG] = space_count[GC_SPACE_YOUNG];
+	stats->tracked[GC_GEN_AGING] = space_count[GC_SPACE_AGING];
+	stats->tracked[GC_GEN_OLD] = space_count[GC_SPACE_OLD_PENDING] + space_count[GC_SPACE_OLD_VISITED];
+}
+
+void CrGC_PrintStats(FILE* out)
+{
+	static const char* names[CrGC_NUM_GENERATIONS] = { "young", "aging", "old" };
+	CrGCStats stats;
+	CrGC_GetStats(&stats);
+
+	fprintf(out, "Thresholds = %d, %d, %d, increment size = %zd.\n",
+		thresholds[GC_GEN_YOUNG], thresholds[GC_GEN_AGING], thresholds[GC_GEN_OLD], increment_size);
+	fprintf(out, "generation    tracked  collections    examined   collected  total pause    max pause\n");
+	fprintf(out, "----------  ---------  -----------  ----------  ----------  -----------  -----------\n");
+
+	for (int i = 0; i < CrGC_NUM_GENERATIONS; i++)
+	{
+		CrGCGenerationStats* gen = &stats.generations[i];
+		fprintf(out, "%10s %10zu %12zu %11zu %11zu %10.3fms %10.3fms\n",
+			names[i], stats.tracked[i], gen->collections, gen->examined, gen->collected,
+			gen->total_pause_ns / 1e6, gen->max_pause_ns / 1e6);
+	}
+
+	fprintf(out, "\n# full passes over the old generation = %zu\n", stats.full_passes);
+	fprintf(out, "# last pause = %.3fms\n", stats.last_pause_ns / 1e6);
+}
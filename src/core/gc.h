@@ -0,0 +1,103 @@
+#pragma once
+
+#include <port.h>
+#include <objects/object.h>
+
+#include <stdio.h>
+
+/*
+ * Cycle garbage collector
+ *
+ * Reference counting can't free objects that refer to each other, so
+ * container types (those with TPFLAGS_HAVE_GC) carry a CrGC_Head in front
+ * of the object and are kept on the collector's lists while they are
+ * tracked. A collection works out which objects in a set are referenced
+ * only from inside the set and breaks those cycles with tp_clear.
+ *
+ * New objects start in the young generation, which is collected once more
+ * than threshold0 objects are waiting in it. Survivors move to the aging
+ * generation, and every threshold1 young collections the aging objects are
+ * collected as well; what survives that is promoted to the old generation.
+ * The old generation is never collected all at once outside CrGC_Collect():
+ * every threshold2 aging collections an increment of it is scanned instead,
+ * so a full pass over a large heap is spread over many short pauses.
+ */
+
+typedef struct _gchead
+{
+	struct _gchead* gc_next;
+	struct _gchead* gc_prev;
+	Cr_size_t gc_refs;			// Scratch reference count during a collection
+	Cr_size_t gc_space;			// Which list the object is on, see gc.cpp
+} CrGC_Head;
+
+#define CrGC_NUM_GENERATIONS	3
+
+/* Allocate an object of a GC type, untracked. It must be freed with
+   CrObject_GC_Del(), so GC types use it as their tp_free. */
+CrObject* CrObject_GC_New(CrTypeObject* type);
+#define CrObject_GC_NEW(type, typedef) (type *)CrObject_GC_New(typedef)
+void CrObject_GC_Del(void* op);
+
+/* Start or stop tracking a fully initialized object. A type's tp_dealloc
+   must untrack the object before it releases anything. */
+void CrObject_GC_Track(void* op);
+void CrObject_GC_UnTrack(void* op);
+int CrObject_GC_IsTracked(CrObject* op);
+
+#define CrObject_IS_GC(op) \
+	(!CrObject_IS_TAGGED(op) && (Cr_TYPE(op)->tp_flags & TPFLAGS_HAVE_GC))
+
+/* Helper for tp_traverse implementations, which name their arguments
+   'visit' and 'arg' */
+#define Cr_VISIT(op)											\
+	do {														\
+		if (op) {												\
+			int vret = visit(CrObject_CAST(op), arg);			\
+			if (vret)											\
+				return vret;									\
+		}														\
+	} while (0)
+
+/* Collect every generation at once, returns the number of objects freed.
+   Does nothing and returns 0 while a collection is already running. */
+Cr_size_t CrGC_Collect();
+
+void CrGC_Enable();
+void CrGC_Disable();
+int CrGC_IsEnabled();
+
+void CrGC_SetThreshold(int threshold0, int threshold1, int threshold2);
+void CrGC_GetThreshold(int* threshold0, int* threshold1, int* threshold2);
+
+/* Minimum number of old objects scanned by one increment. Each increment
+   also takes on twice the number of objects promoted since the last one,
+   so a full pass finishes even while the old generation keeps growing. */
+void CrGC_SetIncrementSize(Cr_size_t size);
+
+/* Print a line to stderr for every collection */
+#define CrGC_DEBUG_STATS		(1 << 0)
+
+void CrGC_SetDebug(int flags);
+int CrGC_GetDebug();
+
+typedef struct _gcgenerationstats
+{
+	size_t collections;			// Number of times this generation was collected
+	size_t collected;			// Objects freed by those collections
+	size_t examined;			// Objects scanned by those collections
+	Cr_uint64_t total_pause_ns;	// Time spent in those collections
+	Cr_uint64_t max_pause_ns;		// Longest single collection
+} CrGCGenerationStats;
+
+typedef struct _gcstats
+{
+	/* Young, aging and old. Old counts both increments and CrGC_Collect(). */
+	CrGCGenerationStats generations[CrGC_NUM_GENERATIONS];
+	size_t tracked[CrGC_NUM_GENERATIONS];	// Objects currently in each generation
+	size_t full_passes;			// Completed passes over the old generation
+	Cr_uint64_t last_pause_ns;		// Duration of the most recent collection
+} CrGCStats;
+
+void CrGC_GetStats(CrGCStats* stats);
+void CrGC_PrintStats(FILE* out);
@@ -0,0 +1,284 @@
+#include "hash.h"
+
+#include <random>
+
+#if defined(_MSC_VER) && defined(_M_X64)
+#	include <intrin.h>
+#endif
+
+/*
+	Keys
+
+	Both algorithms take their keys from a single 64-bit seed, expanded
+	with splitmix64.
+*/
+
+static Cr_uint64_t hash_secret[4] = {
+	0x2d358dccaa6c78a5ULL, 0x8bb84b93962eacc9ULL,
+	0x4b33a62ed433d4a3ULL, 0x4d5a2da51de1aa47ULL
+};
+static Cr_uint64_t hash_seed = 0;
+
+static Cr_uint64_t splitmix64(Cr_uint64_t* state)
+{
+	Cr_uint64_t z = (*state += 0x9e3779b97f4a7c15ULL);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+
+void CrHash_SetSeed(Cr_uint64_t seed)
+{
+	Cr_uint64_t state = seed;
+	hash_seed = splitmix64(&state);
+	for (int i = 0; i < 4; i++)
+		hash_secret[i] = splitmix64(&state) | 1;
+}
+
+void CrHash_Init()
+{
+	std::random_device rd;
+	CrHash_SetSeed(((Cr_uint64_t)rd() << 32) | rd());
+}
+
+/* Unaligned little-endian reads */
+
+static inline Cr_uint64_t read64(const Cr_uint8_t* p)
+{
+	Cr_uint64_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static inline Cr_uint64_t read32(const Cr_uint8_t* p)
+{
+	Cr_uint32_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+#if Cr_HASH_ALGORITHM == CrHash_WYHASH
+
+/*
+	wyhash (final version 4)
+*/
+
+/* 64x64 -> 128 bit multiply, low half in *a and high half in *b */
+static inline void wymum(Cr_uint64_t* a, Cr_uint64_t* b)
+{
+#if defined(__SIZEOF_INT128__)
+	__uint128_t r = *a;
+	r *= *b;
+	*a = (Cr_uint64_t)r;
+	*b = (Cr_uint64_t)(r >> 64);
+#elif defined(_MSC_VER) && defined(_M_X64)
+	*a = _umul128(*a, *b, b);
+#else
+	Cr_uint64_t ha = *a >> 32, hb = *b >> 32, la = (Cr_uint32_t)*a, lb = (Cr_uint32_t)*b;
+	Cr_uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+	Cr_uint64_t t = rl + (rm0 << 32), c = t < rl;
+	Cr_uint64_t lo = t + (rm1 << 32);
+	c += lo < t;
+	*a = lo;
+	*b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+}
+
+static inline Cr_uint64_t wymix(Cr_uint64_t a, Cr_uint64_t b)
+{
+	wymum(&a, &b);
+	return a ^ b;
+}
+
+static inline Cr_uint64_t wyr3(const Cr_uint8_t* p, size_t k)
+{
+	return (((Cr_uint64_t)p[0]) << 16) | (((Cr_uint64_t)p[k >> 1]) << 8) | p[k - 1];
+}
+
+static Cr_uint64_t hash_bytes(const Cr_uint8_t* p, size_t len)
+{
+	const Cr_uint64_t* secret = hash_secret;
+	Cr_uint64_t seed = hash_seed ^ wymix(hash_seed ^ secret[0], secret[1]);
+	Cr_uint64_t a, b;
+
+	if (len <= 16)
+	{
+		if (len >= 4)
+		{
+			a = (read32(p) << 32) | read32(p + ((len >> 3) << 2));
+			b = (read32(p + len - 4) << 32) | read32(p + len - 4 - ((len >> 3) << 2));
+		}
+		else if (len > 0)
+		{
+			a = wyr3(p, len);
+			b = 0;
+		}
+		else
+			a = b = 0;
+	}
+	else
+	{
+		size_t i = len;
+		if (i > 48)
+		{
+			Cr_uint64_t see1 = seed, see2 = seed;
+			do
+			{
+				seed = wymix(read64(p) ^ secret[1], read64(p + 8) ^ seed);
+				see1 = wymix(read64(p + 16) ^ secret[2], read64(p + 24) ^ see1);
+				see2 = wymix(read64(p + 32) ^ secret[3], read64(p + 40) ^ see2);
+				p += 48;
+				i -= 48;
+			} while (i > 48);
+			seed ^= see1 ^ see2;
+		}
+		while (i > 16)
+		{
+			seed = wymix(read64(p) ^ secret[1], read64(p + 8) ^ seed);
+			i -= 16;
+			p += 16;
+		}
+		a = read64(p + i - 16);
+		b = read64(p + i - 8);
+	}
+
+	a ^= secret[1];
+	b ^= seed;
+	wymum(&a, &b);
+	return wymix(a ^ secret[0] ^ len, b ^ secret[1]);
+}
+
+#elif Cr_HASH_ALGORITHM == CrHash_SIPHASH13
+
+/*
+	SipHash-1-3
+*/
+
+#define ROTATE(x, b) (Cr_uint64_t)(((x) << (b)) | ((x) >> (64 - (b))))
+
+#define HALF_ROUND(a, b, c, d, s, t)	\
+	a += b; c += d;						\
+	b = ROTATE(b, s) ^ a;				\
+	d = ROTATE(d, t) ^ c;				\
+	a = ROTATE(a, 32);
+
+#define SINGLE_ROUND(v0, v1, v2, v3)	\
+	HALF_ROUND(v0, v1, v2, v3, 13, 16);	\
+	HALF_ROUND(v2, v1, v0, v3, 17, 21);
+
+static Cr_uint64_t hash_bytes(const Cr_uint8_t* p, size_t len)
+{
+	Cr_uint64_t k0 = hash_secret[0], k1 = hash_secret[1];
+	Cr_uint64_t b = (Cr_uint64_t)len << 56;
+	Cr_uint64_t v0 = k0 ^ 0x736f6d6570736575ULL;
+	Cr_uint64_t v1 = k1 ^ 0x646f72616e646f6dULL;
+	Cr_uint64_t v2 = k0 ^ 0x6c7967656e657261ULL;
+	Cr_uint64_t v3 = k1 ^ 0x7465646279746573ULL;
+
+	while (len >= 8)
+	{
+		Cr_uint64_t mi = read64(p);
+		p += 8;
+		len -= 8;
+		v3 ^= mi;
+		SINGLE_ROUND(v0, v1, v2, v3);
+		v0 ^= mi;
+	}
+
+	Cr_uint64_t t = 0;
+	for (size_t i = 0; i < len; i++)
+		t |= (Cr_uint64_t)p[i] << (8 * i);
+	b |= t;
+
+	v3 ^= b;
+	SINGLE_ROUND(v0, v1, v2, v3);
+	v0 ^= b;
+	v2 ^= 0xff;
+	SINGLE_ROUND(v0, v1, v2, v3);
+	SINGLE_ROUND(v0, v1, v2, v3);
+	SINGLE_ROUND(v0, v1, v2, v3);
+
+	return (v0 ^ v1) ^ (v2 ^ v3);
+}
+
+#else
+#	error "unknown Cr_HASH_ALGORITHM"
+#endif
+
+Cr_hash_t CrHash_Bytes(const void* src, Cr_size_t len)
+{
+	Cr_hash_t x = (Cr_hash_t)hash_bytes((const Cr_uint8_t*)src, (size_t)len);
+	if (x == -1)
+		x = -2;
+	return x;
+}
+
+Cr_hash_t CrHash_Int(Cr_int64_t value)
+{
+	Cr_uint64_t x = value < 0 ? 0 - (Cr_uint64_t)value : (Cr_uint64_t)value;
+	x %= CrHash_MODULUS;
+
+	Cr_hash_t h = value < 0 ? -(Cr_hash_t)x : (Cr_hash_t)x;
+	if (h == -1)
+		h = -2;
+	return h;
+}
+
+/*
+	Reduce the double modulo CrHash_MODULUS exactly, 28 bits of mantissa at
+	a time. For a double equal to an integer this gives the same result as
+	CrHash_Int().
+*/
+Cr_hash_t CrHash_Double(double value)
+{
+	if (!std::isfinite(value))
+	{
+		if (std::isinf(value))
+			return value > 0 ? CrHash_INF : -CrHash_INF;
+		return 0;
+	}
+
+	int e;
+	double m = frexp(value, &e);
+
+	int sign = 1;
+	if (m < 0)
+	{
+		sign = -1;
+		m = -m;
+	}
+
+	size_t x = 0;
+	while (m)
+	{
+		x = ((x << 28) & CrHash_MODULUS) | x >> (CrHash_BITS - 28);
+		m *= 268435456.0; // 2**28
+		e -= 28;
+		size_t y = (size_t)m;
+		m -= y;
+		x += y;
+		if (x >= CrHash_MODULUS)
+			x -= CrHash_MODULUS;
+	}
+
+	e = e >= 0 ? e % CrHash_BITS : CrHash_BITS - 1 - ((-1 - e) % CrHash_BITS);
+	x = ((x << e) & CrHash_MODULUS) | x >> (CrHash_BITS - e);
+
+	Cr_hash_t h = (Cr_hash_t)x * sign;
+	if (h == -1)
+		h = -2;
+	return h;
+}
+
+/* Objects are aligned, so the low bits of their address carry little
+   information. Rotate them to the top. */
+Cr_hash_t CrHash_Pointer(const void* p)
+{
+	size_t y = (size_t)p;
+	y = (y >> 4) | (y << (8 * sizeof(void*) - 4));
+
+	Cr_hash_t h = (Cr_hash_t)y;
+	if (h == -1)
+		h = -2;
+	return h;
+}
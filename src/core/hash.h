@@ -0,0 +1,44 @@
+#pragma once
+
+#include <port.h>
+
+/*
+ * Hashing
+ *
+ * Byte strings are hashed with wyhash by default, which is fast and
+ * distributes well. Defining Cr_HASH_ALGORITHM as CrHash_SIPHASH13 selects
+ * SipHash-1-3 instead, which is slower but keyed strongly enough to resist
+ * hash flooding from untrusted input.
+ *
+ * Numbers hash by value modulo the prime CrHash_MODULUS, so that ints and
+ * floats which compare equal also hash equal.
+ *
+ * No hash function ever returns -1, which is reserved to signal an error
+ * (and, for cached hashes, "not computed yet").
+ */
+
+#define CrHash_WYHASH		1
+#define CrHash_SIPHASH13	2
+
+#ifndef Cr_HASH_ALGORITHM
+#define Cr_HASH_ALGORITHM	CrHash_WYHASH
+#endif
+
+#if SIZE_MAX > 0xffffffffU
+#	define CrHash_BITS		61
+#else
+#	define CrHash_BITS		31
+#endif
+
+#define CrHash_MODULUS		(((size_t)1 << CrHash_BITS) - 1)
+#define CrHash_INF			314159
+
+/* Seed the hash functions. Must run before anything is hashed, since
+   hashes are cached on the objects. */
+void CrHash_Init();
+void CrHash_SetSeed(Cr_uint64_t seed);
+
+Cr_hash_t CrHash_Bytes(const void* src, Cr_size_t len);
+Cr_hash_t CrHash_Int(Cr_int64_t value);
+Cr_hash_t CrHash_Double(double value);
+Cr_hash_t CrHash_Pointer(const void* p);
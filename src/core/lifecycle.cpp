@@ -26,5 +26,18 @@ CrStatus CrCore_InitTypes()
 	if (CrStatus_Exception(status))
 		return status;
 
+	status = CrDict_InitTypes();
+	if (CrStatus_Exception(status))
+		return status;
+
 	return CrStatus_Ok();
 }
+
+void CrCore_ClearFreeLists()
+{
+	CrInt_ClearFreeList();
+	CrFloat_ClearFreeList();
+	CrString_ClearFreeList();
+	CrList_ClearFreeList();
+	CrDict_ClearFreeList();
+}
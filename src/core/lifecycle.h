@@ -2,4 +2,7 @@
 
 #include <core/status.h>
 
-CrStatus CrCore_InitTypes();
\ No newline at end of file
+CrStatus CrCore_InitTypes();
+
+/* Release every object cached on a type free list */
+void CrCore_ClearFreeLists();
\ No newline at end of file
@@ -1,13 +1,20 @@
 #include "mem.h"
 
-void* Mem_Alloc(size_t size)
+#include <algorithm>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+/* Default allocators for the raw and mem domains */
+
+static void* raw_malloc(void*, size_t size)
 {
 	if (size == 0)
 		size = 1;
 	return malloc(size);
 }
 
-void* Mem_Calloc(size_t elemCount, size_t elemSize)
+static void* raw_calloc(void*, size_t elemCount, size_t elemSize)
 {
 	if (elemCount == 0 || elemSize == 0)
 	{
@@ -17,14 +24,825 @@ void* Mem_Calloc(size_t elemCount, size_t elemSize)
 	return calloc(elemCount, elemSize);
 }
 
-void* Mem_Realloc(void* ptr, size_t new_size)
+static void* raw_realloc(void*, void* ptr, size_t new_size)
 {
 	if (new_size == 0)
 		new_size = 1;
 	return realloc(ptr, new_size);
 }
 
-void Mem_Free(void* ptr)
+static void raw_free(void*, void* ptr)
 {
 	free(ptr);
-}
\ No newline at end of file
+}
+
+static void* object_malloc(void* ctx, size_t size);
+static void* object_calloc(void* ctx, size_t elemCount, size_t elemSize);
+static void* object_realloc(void* ctx, void* ptr, size_t new_size);
+static void object_free(void* ctx, void* ptr);
+
+#define RAW_ALLOC		{ NULL, raw_malloc, raw_calloc, raw_realloc, raw_free }
+#define OBJECT_ALLOC	{ NULL, object_malloc, object_calloc, object_realloc, object_free }
+
+/* Constant initialised, so usable before static constructors run */
+static CrMemAllocator mem_raw_allocator = RAW_ALLOC;
+static CrMemAllocator mem_allocator = RAW_ALLOC;
+static CrMemAllocator mem_object_allocator = OBJECT_ALLOC;
+
+/* Set by the entry points while tracing, see Mem_TraceStart() */
+static int mem_tracing = 0;
+static thread_local void* mem_trace_site = NULL;
+
+#define TRACE_SITE() \
+	do { \
+		if (mem_tracing) \
+			mem_trace_site = Cr_RETURN_ADDRESS(); \
+	} while (0)
+
+static CrMemAllocator* get_allocator(CrMemAllocatorDomain domain)
+{
+	switch (domain)
+	{
+	case CrMem_DOMAIN_RAW:
+		return &mem_raw_allocator;
+	case CrMem_DOMAIN_MEM:
+		return &mem_allocator;
+	case CrMem_DOMAIN_OBJ:
+		return &mem_object_allocator;
+	}
+	return NULL;
+}
+
+void Mem_GetAllocator(CrMemAllocatorDomain domain, CrMemAllocator* allocator)
+{
+	CrMemAllocator* a = get_allocator(domain);
+	assert(a);
+	*allocator = *a;
+}
+
+void Mem_SetAllocator(CrMemAllocatorDomain domain, CrMemAllocator* allocator)
+{
+	CrMemAllocator* a = get_allocator(domain);
+	assert(a);
+	*a = *allocator;
+}
+
+void* Mem_RawAlloc(size_t size)
+{
+	TRACE_SITE();
+	return mem_raw_allocator.malloc(mem_raw_allocator.ctx, size);
+}
+
+void* Mem_RawCalloc(size_t elemCount, size_t elemSize)
+{
+	TRACE_SITE();
+	return mem_raw_allocator.calloc(mem_raw_allocator.ctx, elemCount, elemSize);
+}
+
+void* Mem_RawRealloc(void* ptr, size_t new_size)
+{
+	TRACE_SITE();
+	return mem_raw_allocator.realloc(mem_raw_allocator.ctx, ptr, new_size);
+}
+
+void Mem_RawFree(void* ptr)
+{
+	mem_raw_allocator.free(mem_raw_allocator.ctx, ptr);
+}
+
+void* Mem_Alloc(size_t size)
+{
+	TRACE_SITE();
+	return mem_allocator.malloc(mem_allocator.ctx, size);
+}
+
+void* Mem_Calloc(size_t elemCount, size_t elemSize)
+{
+	TRACE_SITE();
+	return mem_allocator.calloc(mem_allocator.ctx, elemCount, elemSize);
+}
+
+void* Mem_Realloc(void* ptr, size_t new_size)
+{
+	TRACE_SITE();
+	return mem_allocator.realloc(mem_allocator.ctx, ptr, new_size);
+}
+
+void Mem_Free(void* ptr)
+{
+	mem_allocator.free(mem_allocator.ctx, ptr);
+}
+
+void* Mem_ObjectAlloc(size_t size)
+{
+	TRACE_SITE();
+	return mem_object_allocator.malloc(mem_object_allocator.ctx, size);
+}
+
+void* Mem_ObjectCalloc(size_t elemCount, size_t elemSize)
+{
+	TRACE_SITE();
+	return mem_object_allocator.calloc(mem_object_allocator.ctx, elemCount, elemSize);
+}
+
+void* Mem_ObjectRealloc(void* ptr, size_t new_size)
+{
+	TRACE_SITE();
+	return mem_object_allocator.realloc(mem_object_allocator.ctx, ptr, new_size);
+}
+
+void Mem_ObjectFree(void* ptr)
+{
+	mem_object_allocator.free(mem_object_allocator.ctx, ptr);
+}
+
+/*
+ * Object allocator
+ *
+ * A size-class allocator in the style of pymalloc. Memory is split into
+ * three levels:
+ *
+ *   arenas - ARENA_SIZE chunks requested from the system allocator
+ *   pools  - POOL_SIZE pieces of an arena, each serving a single size class
+ *   blocks - the pieces of a pool handed out to callers
+ *
+ * Every size class keeps a doubly-linked list of pools that have at least
+ * one free block, so an allocation is usually just a pop from the pool's
+ * free block list. A pool that becomes empty goes back to its arena, and an
+ * arena whose pools are all empty is returned to the system.
+ *
+ * Mem_ObjectFree() has to tell pool memory apart from memory that came from
+ * the system allocator. Every pool header records the index of its arena,
+ * so the pointer is ours if that index names an arena which contains the
+ * pointer. The header read is always inside the same system page as the
+ * pointer itself (POOL_SIZE is no larger than a page), so this is safe even
+ * for foreign pointers.
+ */
+
+#define ALIGNMENT				MEM_ALIGNMENT
+#define ALIGNMENT_SHIFT			4
+#define SMALL_REQUEST_THRESHOLD	MEM_SMALL_REQUEST_THRESHOLD
+#define NB_SMALL_SIZE_CLASSES	MEM_NB_SMALL_SIZE_CLASSES
+
+/* Return the number of bytes in size class I, and the size class of a request */
+#define INDEX2SIZE(I) (((unsigned int)(I) + 1) << ALIGNMENT_SHIFT)
+#define SIZE2INDEX(S) (((unsigned int)(S) - 1) >> ALIGNMENT_SHIFT)
+
+#define POOL_SIZE				(4 * 1024)
+#define POOL_SIZE_MASK			(POOL_SIZE - 1)
+#define ARENA_SIZE				(256 * 1024)
+
+/* Size class marker for pools sitting unused on an arena's free list */
+#define DUMMY_SIZE_IDX			0xffff
+
+typedef Cr_uint8_t mem_block;
+
+typedef struct _pool_header
+{
+	unsigned int count;					// Number of allocated blocks
+	mem_block* freeblock;				// Head of the free block list
+	struct _pool_header* nextpool;		// Next pool of this size class
+	struct _pool_header* prevpool;		// Previous pool of this size class
+	unsigned int arenaindex;			// Index into the arenas array
+	unsigned int szidx;					// Block size class index
+	unsigned int nextoffset;			// Bytes to the next never-used block
+	unsigned int maxnextoffset;			// Largest valid nextoffset
+} pool_header;
+
+typedef pool_header* poolp;
+
+#define POOL_OVERHEAD Cr_SIZE_ROUND_UP(sizeof(pool_header), ALIGNMENT)
+
+/* Round pointer P down to the start of the pool holding it */
+#define POOL_ADDR(P) ((poolp)Cr_ALIGN_DOWN((P), POOL_SIZE))
+
+typedef struct _arena_object
+{
+	/* Address returned by the system allocator, 0 if this arena object
+	   is not associated with an allocated arena. */
+	uintptr_t address;
+
+	/* Pool-aligned pointer to the next pool that has never been carved */
+	mem_block* pool_address;
+
+	/* Number of available pools in the arena: free pools plus never
+	   carved pools. */
+	unsigned int nfreepools;
+	unsigned int ntotalpools;
+
+	/* Singly-linked list of pools that were used and are empty again */
+	poolp freepools;
+
+	/* Links for the usable_arenas list (arenas with nfreepools > 0), or the
+	   unused_arena_objects list via nextarena only. */
+	struct _arena_object* nextarena;
+	struct _arena_object* prevarena;
+} arena_object;
+
+/* Number of arena objects allocated when the arenas array grows */
+#define INITIAL_ARENA_OBJECTS 16
+
+/* All allocator state is zero-initialised so that it is usable before
+   static constructors run; objects are created during static initialisation. */
+static arena_object* arenas = NULL;
+static unsigned int maxarenas = 0;
+static arena_object* unused_arena_objects = NULL;
+static arena_object* usable_arenas = NULL;
+static poolp usedpools[NB_SMALL_SIZE_CLASSES];
+
+static size_t narenas_currently_allocated = 0;
+static size_t narenas_highwater = 0;
+static size_t nlarge_allocs = 0;
+static size_t class_allocs[NB_SMALL_SIZE_CLASSES];
+static size_t class_frees[NB_SMALL_SIZE_CLASSES];
+
+static arena_object* new_arena()
+{
+	arena_object* arenaobj;
+	uintptr_t excess;
+
+	if (unused_arena_objects == NULL)
+	{
+		/* Grow the arenas array; pool headers refer to arenas by index
+		   so the array may move. */
+		unsigned int numarenas = maxarenas ? maxarenas << 1 : INITIAL_ARENA_OBJECTS;
+		if (numarenas <= maxarenas)
+			return NULL; // Overflow
+		arena_object* newarenas = (arena_object*)Mem_RawRealloc(arenas, numarenas * sizeof(arena_object));
+		if (newarenas == NULL)
+			return NULL;
+		arenas = newarenas;
+
+		for (unsigned int i = maxarenas; i < numarenas; i++)
+		{
+			arenas[i].address = 0;
+			arenas[i].nextarena = i < numarenas - 1 ? &arenas[i + 1] : NULL;
+		}
+		unused_arena_objects = &arenas[maxarenas];
+		maxarenas = numarenas;
+	}
+
+	arenaobj = unused_arena_objects;
+	void* address = Mem_RawAlloc(ARENA_SIZE);
+	if (address == NULL)
+		return NULL;
+	unused_arena_objects = arenaobj->nextarena;
+	arenaobj->address = (uintptr_t)address;
+
+	narenas_currently_allocated++;
+	if (narenas_currently_allocated > narenas_highwater)
+		narenas_highwater = narenas_currently_allocated;
+
+	arenaobj->freepools = NULL;
+	arenaobj->pool_address = (mem_block*)arenaobj->address;
+	arenaobj->nfreepools = ARENA_SIZE / POOL_SIZE;
+	excess = arenaobj->address & POOL_SIZE_MASK;
+	if (excess != 0)
+	{
+		/* The first partial pool is lost to alignment */
+		arenaobj->nfreepools--;
+		arenaobj->pool_address += POOL_SIZE - excess;
+	}
+	arenaobj->ntotalpools = arenaobj->nfreepools;
+	return arenaobj;
+}
+
+/* address_in_range() reads the pool header of blocks that may not come
+   from a pool at all, which address sanitizers report as an overflow. It
+   is kept out of line so the exemption can't be lost by inlining. */
+#if defined(__SANITIZE_ADDRESS__)
+#	ifdef _MSC_VER
+#		define MEM_NO_SANITIZE_ADDRESS __declspec(no_sanitize_address) __declspec(noinline)
+#	else
+#		define MEM_NO_SANITIZE_ADDRESS __attribute__((no_sanitize_address, noinline))
+#	endif
+#elif defined(__has_feature)
+#	if __has_feature(address_sanitizer)
+#		define MEM_NO_SANITIZE_ADDRESS __attribute__((no_sanitize("address"), noinline))
+#	endif
+#endif
+#ifndef MEM_NO_SANITIZE_ADDRESS
+#	ifdef _MSC_VER
+#		define MEM_NO_SANITIZE_ADDRESS __declspec(noinline)
+#	else
+#		define MEM_NO_SANITIZE_ADDRESS __attribute__((noinline))
+#	endif
+#endif
+
+MEM_NO_SANITIZE_ADDRESS
+static int address_in_range(void* p, poolp pool)
+{
+	unsigned int arenaindex = *((volatile unsigned int*)&pool->arenaindex);
+	return arenaindex < maxarenas &&
+		(uintptr_t)p - arenas[arenaindex].address < ARENA_SIZE &&
+		arenas[arenaindex].address != 0;
+}
+
+static void usable_arenas_unlink(arena_object* ao)
+{
+	if (ao->prevarena == NULL)
+		usable_arenas = ao->nextarena;
+	else
+		ao->prevarena->nextarena = ao->nextarena;
+	if (ao->nextarena != NULL)
+		ao->nextarena->prevarena = ao->prevarena;
+}
+
+static void usable_arenas_push(arena_object* ao)
+{
+	ao->nextarena = usable_arenas;
+	ao->prevarena = NULL;
+	if (usable_arenas != NULL)
+		usable_arenas->prevarena = ao;
+	usable_arenas = ao;
+}
+
+/* Take a pool for size class 'size' from a usable arena and link it into
+   usedpools. Returns NULL if no memory is available. */
+static poolp pool_new(unsigned int size)
+{
+	poolp pool;
+
+	if (usable_arenas == NULL)
+	{
+		arena_object* ao = new_arena();
+		if (ao == NULL)
+			return NULL;
+		usable_arenas_push(ao);
+	}
+
+	arena_object* ao = usable_arenas;
+	assert(ao->nfreepools > 0);
+
+	pool = ao->freepools;
+	if (pool != NULL)
+	{
+		ao->freepools = pool->nextpool;
+	}
+	else
+	{
+		/* Carve a brand new pool off the arena */
+		pool = (poolp)ao->pool_address;
+		pool->arenaindex = (unsigned int)(ao - arenas);
+		ao->pool_address += POOL_SIZE;
+	}
+	if (--ao->nfreepools == 0)
+		usable_arenas_unlink(ao);
+
+	pool->szidx = size;
+	size = INDEX2SIZE(size);
+	pool->count = 1;
+	pool->freeblock = NULL;
+	pool->nextoffset = POOL_OVERHEAD + size;
+	pool->maxnextoffset = POOL_SIZE - size;
+
+	pool->nextpool = usedpools[pool->szidx];
+	pool->prevpool = NULL;
+	if (pool->nextpool != NULL)
+		pool->nextpool->prevpool = pool;
+	usedpools[pool->szidx] = pool;
+
+	return pool;
+}
+
+static void pool_unlink(poolp pool)
+{
+	if (pool->prevpool == NULL)
+		usedpools[pool->szidx] = pool->nextpool;
+	else
+		pool->prevpool->nextpool = pool->nextpool;
+	if (pool->nextpool != NULL)
+		pool->nextpool->prevpool = pool->prevpool;
+}
+
+static void* pool_alloc(size_t nbytes)
+{
+	unsigned int size = SIZE2INDEX(nbytes);
+	poolp pool = usedpools[size];
+	mem_block* bp;
+
+	if (pool == NULL)
+	{
+		pool = pool_new(size);
+		if (pool == NULL)
+			return NULL;
+		/* The first block of a fresh pool is handed out directly */
+		class_allocs[size]++;
+		return (mem_block*)pool + POOL_OVERHEAD;
+	}
+
+	pool->count++;
+	bp = pool->freeblock;
+	if (bp != NULL)
+	{
+		pool->freeblock = *(mem_block**)bp;
+	}
+	else
+	{
+		/* Extend the pool into its never-used tail */
+		assert(pool->nextoffset <= pool->maxnextoffset);
+		bp = (mem_block*)pool + pool->nextoffset;
+		pool->nextoffset += INDEX2SIZE(size);
+	}
+
+	/* Unlink the pool once it has no blocks left to give */
+	if (pool->freeblock == NULL && pool->nextoffset > pool->maxnextoffset)
+		pool_unlink(pool);
+
+	class_allocs[size]++;
+	return bp;
+}
+
+static void pool_free(poolp pool, void* p)
+{
+	arena_object* ao;
+	int was_full = pool->freeblock == NULL && pool->nextoffset > pool->maxnextoffset;
+
+	*(mem_block**)p = pool->freeblock;
+	pool->freeblock = (mem_block*)p;
+	pool->count--;
+	class_frees[pool->szidx]++;
+
+	if (was_full)
+	{
+		/* The pool is usable again, put it in front of its size class */
+		pool->nextpool = usedpools[pool->szidx];
+		pool->prevpool = NULL;
+		if (pool->nextpool != NULL)
+			pool->nextpool->prevpool = pool;
+		usedpools[pool->szidx] = pool;
+	}
+
+	if (pool->count != 0)
+		return;
+
+	/* The pool is empty, give it back to its arena */
+	pool_unlink(pool);
+	pool->szidx = DUMMY_SIZE_IDX;
+	ao = &arenas[pool->arenaindex];
+	pool->nextpool = ao->freepools;
+	ao->freepools = pool;
+	ao->nfreepools++;
+
+	if (ao->nfreepools == 1)
+	{
+		/* The arena was full and is usable again */
+		usable_arenas_push(ao);
+	}
+	else if (ao->nfreepools == ao->ntotalpools && usable_arenas->nextarena != NULL)
+	{
+		/* Every pool is free, release the arena unless it is the last usable one */
+		usable_arenas_unlink(ao);
+		Mem_RawFree((void*)ao->address);
+		ao->address = 0;
+		ao->nextarena = unused_arena_objects;
+		unused_arena_objects = ao;
+		narenas_currently_allocated--;
+	}
+}
+
+static void* object_malloc(void*, size_t size)
+{
+	if (size != 0 && size <= SMALL_REQUEST_THRESHOLD)
+	{
+		void* p = pool_alloc(size);
+		if (p != NULL)
+			return p;
+	}
+	nlarge_allocs++;
+	return Mem_RawAlloc(size);
+}
+
+static void* object_calloc(void* ctx, size_t elemCount, size_t elemSize)
+{
+	if (elemSize != 0 && elemCount > CR_SIZE_T_MAX / elemSize)
+		return NULL;
+
+	size_t size = elemCount * elemSize;
+	void* p = object_malloc(ctx, size);
+	if (p != NULL)
+		memset(p, 0, size);
+	return p;
+}
+
+static void* object_realloc(void* ctx, void* ptr, size_t new_size)
+{
+	if (ptr == NULL)
+		return object_malloc(ctx, new_size);
+
+	poolp pool = POOL_ADDR(ptr);
+	if (!address_in_range(ptr, pool))
+		return Mem_RawRealloc(ptr, new_size);
+
+	size_t size = INDEX2SIZE(pool->szidx);
+	if (new_size <= size)
+	{
+		/* Shrinking in place is fine as long as it does not waste more
+		   than a quarter of the block. */
+		if (4 * new_size > 3 * size)
+			return ptr;
+		size = new_size;
+	}
+
+	void* p = object_malloc(ctx, new_size);
+	if (p != NULL)
+	{
+		memcpy(p, ptr, size);
+		pool_free(pool, ptr);
+	}
+	return p;
+}
+
+static void object_free(void*, void* ptr)
+{
+	if (ptr == NULL)
+		return;
+
+	poolp pool = POOL_ADDR(ptr);
+	if (address_in_range(ptr, pool))
+	{
+		pool_free(pool, ptr);
+		return;
+	}
+	Mem_RawFree(ptr);
+}
+
+void Mem_GetStats(CrMemStats* stats)
+{
+	memset(stats, 0, sizeof(CrMemStats));
+	stats->arenas = narenas_currently_allocated;
+	stats->peak_arenas = narenas_highwater;
+	stats->arena_size = ARENA_SIZE;
+	stats->pool_size = POOL_SIZE;
+	stats->large_allocs = nlarge_allocs;
+
+	for (unsigned int i = 0; i < NB_SMALL_SIZE_CLASSES; i++)
+	{
+		CrMemSizeClassStats* cls = &stats->classes[i];
+		cls->block_size = INDEX2SIZE(i);
+		cls->total_allocs = class_allocs[i];
+		cls->total_frees = class_frees[i];
+	}
+
+	for (unsigned int i = 0; i < maxarenas; i++)
+	{
+		if (arenas[i].address == 0)
+			continue;
+
+		mem_block* base = (mem_block*)Cr_ALIGN_UP(arenas[i].address, POOL_SIZE);
+		for (mem_block* b = base; b < arenas[i].pool_address; b += POOL_SIZE)
+		{
+			poolp pool = (poolp)b;
+			if (pool->szidx == DUMMY_SIZE_IDX)
+				continue;
+
+			CrMemSizeClassStats* cls = &stats->classes[pool->szidx];
+			size_t capacity = (POOL_SIZE - POOL_OVERHEAD) / cls->block_size;
+			cls->pools++;
+			cls->blocks_used += pool->count;
+			cls->blocks_free += capacity - pool->count;
+		}
+	}
+}
+
+void Mem_PrintStats(FILE* out)
+{
+	CrMemStats stats;
+	Mem_GetStats(&stats);
+
+	fprintf(out, "Small block threshold = %d, in %d size classes.\n",
+		SMALL_REQUEST_THRESHOLD, NB_SMALL_SIZE_CLASSES);
+	fprintf(out, "class   size   num pools   blocks in use  avail blocks      allocs       frees\n");
+	fprintf(out, "-----   ----   ---------   -------------  ------------  ----------  ----------\n");
+
+	size_t total_used = 0, total_free = 0;
+	for (unsigned int i = 0; i < NB_SMALL_SIZE_CLASSES; i++)
+	{
+		CrMemSizeClassStats* cls = &stats.classes[i];
+		if (cls->total_allocs == 0)
+			continue;
+		fprintf(out, "%5u %6zu %11zu %15zu %13zu %11zu %11zu\n",
+			i, cls->block_size, cls->pools, cls->blocks_used, cls->blocks_free,
+			cls->total_allocs, cls->total_frees);
+		total_used += cls->blocks_used * cls->block_size;
+		total_free += cls->blocks_free * cls->block_size;
+	}
+
+	fprintf(out, "\n# arenas allocated current = %zu\n", stats.arenas);
+	fprintf(out, "# arenas highwater mark    = %zu\n", stats.peak_arenas);
+	fprintf(out, "# bytes in allocated blocks = %zu\n", total_used);
+	fprintf(out, "# bytes in available blocks = %zu\n", total_free);
+	fprintf(out, "# large requests forwarded  = %zu\n", stats.large_allocs);
+}
+
+/*
+ * Allocation tracing
+ *
+ * The tracer wraps each domain's allocator, keeping the wrapped one as the
+ * context. Bookkeeping lives in std containers, which allocate through
+ * operator new rather than Mem_*, so the tracer never traces itself.
+ */
+
+typedef struct _trace_key
+{
+	CrMemAllocatorDomain domain;
+	void* site;
+
+	bool operator==(const _trace_key& other) const
+	{
+		return domain == other.domain && site == other.site;
+	}
+} trace_key;
+
+struct trace_key_hash
+{
+	size_t operator()(const trace_key& key) const
+	{
+		return std::hash<void*>()(key.site) ^ (size_t)key.domain;
+	}
+};
+
+typedef struct _trace_block
+{
+	size_t size;
+	trace_key key;
+} trace_block;
+
+static CrMemAllocator trace_wrapped[CrMem_NB_DOMAINS];
+static std::mutex trace_lock;
+static std::unordered_map<trace_key, CrMemTraceSite, trace_key_hash> trace_sites;
+static std::unordered_map<void*, trace_block> trace_blocks;
+
+/* Nesting depth of traced calls on this thread, only the outermost call is
+   recorded */
+static thread_local int trace_depth = 0;
+
+static void trace_add(CrMemAllocatorDomain domain, void* site, void* ptr, size_t size)
+{
+	std::lock_guard<std::mutex> guard(trace_lock);
+	trace_key key = { domain, site };
+	CrMemTraceSite& entry = trace_sites[key];
+	entry.domain = domain;
+	entry.site = site;
+	entry.count++;
+	entry.size += size;
+	entry.live_count++;
+	entry.live_size += size;
+	trace_blocks[ptr] = { size, key };
+}
+
+static void trace_remove(void* ptr)
+{
+	std::lock_guard<std::mutex> guard(trace_lock);
+	auto it = trace_blocks.find(ptr);
+	if (it == trace_blocks.end())
+		return; // Allocated before tracing started
+
+	auto site = trace_sites.find(it->second.key);
+	if (site != trace_sites.end())
+	{
+		site->second.live_count--;
+		site->second.live_size -= it->second.size;
+	}
+	trace_blocks.erase(it);
+}
+
+#define TRACE_DOMAIN(ctx) ((CrMemAllocatorDomain)((CrMemAllocator*)(ctx) - trace_wrapped))
+
+static void* trace_malloc(void* ctx, size_t size)
+{
+	CrMemAllocator* wrapped = (CrMemAllocator*)ctx;
+	void* site = mem_trace_site;
+
+	trace_depth++;
+	void* p = wrapped->malloc(wrapped->ctx, size);
+	trace_depth--;
+
+	if (p != NULL && trace_depth == 0)
+		trace_add(TRACE_DOMAIN(ctx), site, p, size);
+	return p;
+}
+
+static void* trace_calloc(void* ctx, size_t elemCount, size_t elemSize)
+{
+	CrMemAllocator* wrapped = (CrMemAllocator*)ctx;
+	void* site = mem_trace_site;
+
+	trace_depth++;
+	void* p = wrapped->calloc(wrapped->ctx, elemCount, elemSize);
+	trace_depth--;
+
+	if (p != NULL && trace_depth == 0)
+		trace_add(TRACE_DOMAIN(ctx), site, p, elemCount * elemSize);
+	return p;
+}
+
+static void* trace_realloc(void* ctx, void* ptr, size_t new_size)
+{
+	CrMemAllocator* wrapped = (CrMemAllocator*)ctx;
+	void* site = mem_trace_site;
+
+	trace_depth++;
+	void* p = wrapped->realloc(wrapped->ctx, ptr, new_size);
+	trace_depth--;
+
+	if (p != NULL && trace_depth == 0)
+	{
+		if (ptr != NULL)
+			trace_remove(ptr);
+		trace_add(TRACE_DOMAIN(ctx), site, p, new_size);
+	}
+	return p;
+}
+
+static void trace_free(void* ctx, void* ptr)
+{
+	CrMemAllocator* wrapped = (CrMemAllocator*)ctx;
+
+	if (ptr != NULL && trace_depth == 0)
+		trace_remove(ptr);
+
+	trace_depth++;
+	wrapped->free(wrapped->ctx, ptr);
+	trace_depth--;
+}
+
+int Mem_TraceStart()
+{
+	if (mem_tracing)
+		return 0;
+
+	for (int i = 0; i < CrMem_NB_DOMAINS; i++)
+	{
+		CrMemAllocatorDomain domain = (CrMemAllocatorDomain)i;
+		Mem_GetAllocator(domain, &trace_wrapped[i]);
+
+		CrMemAllocator tracer = { &trace_wrapped[i], trace_malloc, trace_calloc, trace_realloc, trace_free };
+		Mem_SetAllocator(domain, &tracer);
+	}
+	mem_tracing = 1;
+	return 0;
+}
+
+void Mem_TraceStop()
+{
+	if (!mem_tracing)
+		return;
+
+	/* Blocks allocated while tracing are plain blocks of the wrapped
+	   allocators, so they can be freed by them directly. */
+	for (int i = 0; i < CrMem_NB_DOMAINS; i++)
+		Mem_SetAllocator((CrMemAllocatorDomain)i, &trace_wrapped[i]);
+	mem_tracing = 0;
+	Mem_TraceClear();
+}
+
+int Mem_IsTracing()
+{
+	return mem_tracing;
+}
+
+void Mem_TraceClear()
+{
+	std::lock_guard<std::mutex> guard(trace_lock);
+	trace_sites.clear();
+	trace_blocks.clear();
+}
+
+size_t Mem_TraceGetSites(CrMemTraceSite* sites, size_t max)
+{
+	std::vector<CrMemTraceSite> all;
+	{
+		std::lock_guard<std::mutex> guard(trace_lock);
+		all.reserve(trace_sites.size());
+		for (auto& entry : trace_sites)
+			all.push_back(entry.second);
+	}
+
+	std::sort(all.begin(), all.end(), [](const CrMemTraceSite& a, const CrMemTraceSite& b) {
+		return a.size > b.size;
+	});
+
+	size_t n = std::min(max, all.size());
+	std::copy(all.begin(), all.begin() + n, sites);
+	return all.size();
+}
+
+void Mem_TracePrint(FILE* out, size_t limit)
+{
+	static const char* domain_names[CrMem_NB_DOMAINS] = { "raw", "mem", "object" };
+
+	std::vector<CrMemTraceSite> sites(limit);
+	size_t total = Mem_TraceGetSites(sites.data(), limit);
+	sites.resize(std::min(limit, total));
+
+	fprintf(out, "domain  site                    allocs       bytes  live allocs  live bytes\n");
+	fprintf(out, "------  ------------------  ----------  ----------  -----------  ----------\n");
+	for (CrMemTraceSite& site : sites)
+	{
+		fprintf(out, "%-6s  %18p  %10zu  %10zu  %11zu  %10zu\n",
+			domain_names[site.domain], site.site, site.count, site.size,
+			site.live_count, site.live_size);
+	}
+	fprintf(out, "\n# call sites recorded = %zu\n", total);
+}
@@ -2,7 +2,118 @@
 
 #include "../port.h"
 
+/*
+ * Allocator domains
+ *
+ *   raw    - Mem_Raw*(), plain system memory, also backs the object allocator
+ *   mem    - Mem_Alloc() and friends, general purpose buffers
+ *   object - Mem_Object*(), memory for CrObject instances
+ *
+ * Each domain dispatches through a CrMemAllocator that can be replaced with
+ * Mem_SetAllocator(). A domain's allocator must be replaced before anything
+ * is allocated from it, or wrap the previous allocator (see
+ * Mem_GetAllocator()) so that memory it handed out is still freed by it.
+ */
+
+typedef enum _memdomain
+{
+	CrMem_DOMAIN_RAW,
+	CrMem_DOMAIN_MEM,
+	CrMem_DOMAIN_OBJ
+} CrMemAllocatorDomain;
+
+#define CrMem_NB_DOMAINS 3
+
+typedef struct _memallocator
+{
+	void* ctx;		// User context passed as the first argument
+	void* (*malloc)(void* ctx, size_t size);
+	void* (*calloc)(void* ctx, size_t elemCount, size_t elemSize);
+	void* (*realloc)(void* ctx, void* ptr, size_t new_size);
+	void (*free)(void* ctx, void* ptr);
+} CrMemAllocator;
+
+void Mem_GetAllocator(CrMemAllocatorDomain domain, CrMemAllocator* allocator);
+void Mem_SetAllocator(CrMemAllocatorDomain domain, CrMemAllocator* allocator);
+
+void* Mem_RawAlloc(size_t size);
+void* Mem_RawCalloc(size_t elemCount, size_t elemSize);
+void* Mem_RawRealloc(void* ptr, size_t new_size);
+void Mem_RawFree(void* ptr);
+
 void* Mem_Alloc(size_t size);
 void* Mem_Calloc(size_t elemCount, size_t elemSize);
 void* Mem_Realloc(void* ptr, size_t new_size);
-void Mem_Free(void* ptr);
\ No newline at end of file
+void Mem_Free(void* ptr);
+
+/*
+ * Object allocator
+ *
+ * Requests of up to MEM_SMALL_REQUEST_THRESHOLD bytes are served from pools
+ * of equally sized blocks carved out of large arenas, everything bigger is
+ * forwarded to the system allocator. Memory handed out by Mem_ObjectAlloc()
+ * must be released with Mem_ObjectFree().
+ */
+
+#define MEM_ALIGNMENT					16
+#define MEM_SMALL_REQUEST_THRESHOLD		512
+#define MEM_NB_SMALL_SIZE_CLASSES		(MEM_SMALL_REQUEST_THRESHOLD / MEM_ALIGNMENT)
+
+void* Mem_ObjectAlloc(size_t size);
+void* Mem_ObjectCalloc(size_t elemCount, size_t elemSize);
+void* Mem_ObjectRealloc(void* ptr, size_t new_size);
+void Mem_ObjectFree(void* ptr);
+
+typedef struct _memsizeclassstats
+{
+	size_t block_size;		// Size of the blocks handed out for this class
+	size_t pools;			// Pools currently carved for this class
+	size_t blocks_used;		// Blocks currently allocated
+	size_t blocks_free;		// Blocks available in this class's pools
+	size_t total_allocs;	// Number of allocations served since startup
+	size_t total_frees;		// Number of frees since startup
+} CrMemSizeClassStats;
+
+typedef struct _memstats
+{
+	size_t arenas;			// Arenas currently allocated
+	size_t peak_arenas;		// Highest number of arenas allocated at once
+	size_t arena_size;		// Size of a single arena in bytes
+	size_t pool_size;		// Size of a single pool in bytes
+	size_t large_allocs;	// Requests forwarded to the system allocator
+	CrMemSizeClassStats classes[MEM_NB_SMALL_SIZE_CLASSES];
+} CrMemStats;
+
+void Mem_GetStats(CrMemStats* stats);
+void Mem_PrintStats(FILE* out);
+
+/*
+ * Allocation tracing
+ *
+ * Mem_TraceStart() wraps the allocator of every domain and records, per
+ * domain and call site, how many allocations were made and how many bytes
+ * they requested, as well as what is still alive. The call site is the
+ * return address of the Mem_* entry point, which tools like addr2line can
+ * map back to a source line. Requests the allocators make internally (e.g.
+ * the object allocator asking for a new arena) are not recorded.
+ */
+
+typedef struct _memtracesite
+{
+	CrMemAllocatorDomain domain;
+	void* site;				// Return address of the Mem_* call
+	size_t count;			// Allocations made from this site
+	size_t size;			// Bytes requested from this site
+	size_t live_count;		// Allocations from this site not yet freed
+	size_t live_size;		// Bytes from this site not yet freed
+} CrMemTraceSite;
+
+int Mem_TraceStart();
+void Mem_TraceStop();
+int Mem_IsTracing();
+void Mem_TraceClear();
+
+/* Copy up to 'max' sites, largest 'size' first, into 'sites'. Returns the
+   number of sites recorded, which may be more than 'max'. */
+size_t Mem_TraceGetSites(CrMemTraceSite* sites, size_t max);
+void Mem_TracePrint(FILE* out, size_t limit);
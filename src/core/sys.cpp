@@ -6,7 +6,14 @@ char* CrSys_ReadLine(const char* prompt)
 {
 	printf("%s", prompt);
 	std::string l;
-	std::getline(std::cin, l);
+	if (!std::getline(std::cin, l))
+	{
+		// End of input, the tokenizer takes an empty line as EOF
+		char* result = (char*)Mem_Alloc(1);
+		if (result != NULL)
+			result[0] = '\0';
+		return result;
+	}
 
 	char* result = (char*)Mem_Alloc(l.size() + 2);
 	memcpy(result, l.c_str(), l.size());
@@ -32,10 +32,29 @@ static int Cr_RunStdin()
 	return (run != 0);
 }
 
-static int Cr_RunCronus(int *exitcode)
+// Run a script file
+static int Cr_RunFile(const char* filename)
+{
+	std::ifstream file(filename, std::ios::binary);
+	if (!file.is_open())
+	{
+		std::cout << "Error: can't open file '" << filename << "'" << std::endl;
+		return 2;
+	}
+	int run = CrRun_FileObject(&file, filename, true);
+	return (run != 0);
+}
+
+static int Cr_RunCronus(const char* filename, int *exitcode)
 {
 	CrInterpreterState* interp = CrInterpreterState_Get();
 
+	if (filename != NULL)
+	{
+		*exitcode = Cr_RunFile(filename);
+		return 0;
+	}
+
 	CrMain_Header();
 
 	*exitcode = Cr_RunStdin();
@@ -43,7 +62,7 @@ static int Cr_RunCronus(int *exitcode)
 	return 0;
 }
 
-int Cr_RunMain()
+int Cr_RunMain(int argc, char** argv)
 {
 	CrStatus status = CrMain_Init();
 
@@ -56,7 +75,7 @@ int Cr_RunMain()
 
 	int exitcode = 0;
 
-	Cr_RunCronus(&exitcode);
+	Cr_RunCronus(argc > 1 ? argv[1] : NULL, &exitcode);
 	CrMain_Free();
 
 	return exitcode;
@@ -64,5 +83,5 @@ int Cr_RunMain()
 
 int main(int argc, char** argv)
 {
-	return Cr_RunMain();
+	return Cr_RunMain(argc, argv);
 }
\ No newline at end of file
@@ -0,0 +1,411 @@
+#include "abstract.h"
+
+#include <core/error.h>
+#include <objects/boolobject.h>
+#include <objects/floatobject.h>
+#include <objects/intobject.h>
+#include <objects/stringobject.h>
+
+#include <stddef.h>
+
+/*
+*
+*		Errors
+*
+*/
+
+static void type_error(const char* format, CrObject* a, CrObject* b)
+{
+	char msg[256];
+	if (b != NULL)
+		snprintf(msg, sizeof(msg), format, Cr_TYPE(a)->tp_name, Cr_TYPE(b)->tp_name);
+	else
+		snprintf(msg, sizeof(msg), format, Cr_TYPE(a)->tp_name);
+	CrError_SetString(CrExc_TypeError, msg);
+}
+
+/*
+*
+*		Numbers
+*
+*/
+
+#define NB_SLOT(x) offsetof(CrNumberMethods, x)
+#define NB_BINOP(nb_methods, slot) \
+	(*(binaryfunc*)(&((char*)(nb_methods))[slot]))
+
+static inline binaryfunc binary_slot(CrObject* op, size_t slot)
+{
+	CrNumberMethods* nb = Cr_TYPE(op)->tp_as_number;
+	return nb != NULL ? NB_BINOP(nb, slot) : NULL;
+}
+
+/* Try a's slot and then b's, with b first if its type is a subtype of a's
+   so that a subclass can override the operation. Returns a new reference
+   to Cr_NotImplemented if neither handles the operands. */
+static CrObject* binary_op1(CrObject* a, CrObject* b, size_t slot)
+{
+	binaryfunc slota = binary_slot(a, slot);
+	binaryfunc slotb = NULL;
+	if (!Cr_IS_TYPE(b, Cr_TYPE(a)))
+	{
+		slotb = binary_slot(b, slot);
+		if (slotb == slota)
+			slotb = NULL;
+	}
+
+	CrObject* x;
+	if (slota != NULL)
+	{
+		if (slotb != NULL && CrType_IsSubtype(Cr_TYPE(b), Cr_TYPE(a)))
+		{
+			x = slotb(a, b);
+			if (x != Cr_NotImplemented)
+				return x;
+			CrObject_DECREF(x);
+			slotb = NULL;
+		}
+		x = slota(a, b);
+		if (x != Cr_NotImplemented)
+			return x;
+		CrObject_DECREF(x);
+	}
+	if (slotb != NULL)
+	{
+		x = slotb(a, b);
+		if (x != Cr_NotImplemented)
+			return x;
+		CrObject_DECREF(x);
+	}
+	Cr_RETURN_NOTIMPLEMENTED;
+}
+
+static CrObject* binary_op(CrObject* a, CrObject* b, size_t slot, const char* op_name)
+{
+	CrObject* result = binary_op1(a, b, slot);
+	if (result == Cr_NotImplemented)
+	{
+		CrObject_DECREF(result);
+		char format[96];
+		snprintf(format, sizeof(format), "unsupported operand type(s) for %s: '%%.100s' and '%%.100s'", op_name);
+		type_error(format, a, b);
+		return NULL;
+	}
+	return result;
+}
+
+/* Both operands exact floats, so the common case needs no dispatch */
+#define FLOAT_BINOP(a, b, op)												\
+	if (CrFloat_CheckExact(a) && CrFloat_CheckExact(b))						\
+		return CrFloatObject_FromDouble(									\
+			((CrFloatObject*)(a))->ob_fval op ((CrFloatObject*)(b))->ob_fval)
+
+CrObject* CrNumber_Add(CrObject* a, CrObject* b)
+{
+	if (CrInt_CheckExact(a) && CrInt_CheckExact(b))
+		return CrInt_Add(a, b);
+	FLOAT_BINOP(a, b, +);
+	if (CrString_CheckExact(a) && CrString_CheckExact(b))
+		return CrString_Concat(a, b);
+	return binary_op(a, b, NB_SLOT(nb_add), "+");
+}
+
+CrObject* CrNumber_Subtract(CrObject* a, CrObject* b)
+{
+	if (CrInt_CheckExact(a) && CrInt_CheckExact(b))
+		return CrInt_Subtract(a, b);
+	FLOAT_BINOP(a, b, -);
+	return binary_op(a, b, NB_SLOT(nb_subtract), "-");
+}
+
+CrObject* CrNumber_Multiply(CrObject* a, CrObject* b)
+{
+	if (CrInt_CheckExact(a) && CrInt_CheckExact(b))
+		return CrInt_Multiply(a, b);
+	FLOAT_BINOP(a, b, *);
+	return binary_op(a, b, NB_SLOT(nb_multiply), "*");
+}
+
+CrObject* CrNumber_Remainder(CrObject* a, CrObject* b)
+{
+	if (CrInt_CheckExact(a) && CrInt_CheckExact(b))
+		return CrInt_Remainder(a, b);
+	return binary_op(a, b, NB_SLOT(nb_remainder), "%");
+}
+
+CrObject* CrNumber_FloorDivide(CrObject* a, CrObject* b)
+{
+	if (CrInt_CheckExact(a) && CrInt_CheckExact(b))
+		return CrInt_FloorDivide(a, b);
+	return binary_op(a, b, NB_SLOT(nb_floor_divide), "//");
+}
+
+CrObject* CrNumber_TrueDivide(CrObject* a, CrObject* b)
+{
+	if (CrInt_CheckExact(a) && CrInt_CheckExact(b))
+		return CrInt_TrueDivide(a, b);
+	if (CrFloat_CheckExact(a) && CrFloat_CheckExact(b) && ((CrFloatObject*)b)->ob_fval != 0.0)
+		return CrFloatObject_FromDouble(((CrFloatObject*)a)->ob_fval / ((CrFloatObject*)b)->ob_fval);
+	return binary_op(a, b, NB_SLOT(nb_true_divide), "/");
+}
+
+#define UNARY_OP(op, slot, op_name)											\
+	do {																	\
+		CrNumberMethods* nb = Cr_TYPE(op)->tp_as_number;					\
+		if (nb != NULL && nb->slot != NULL)									\
+			return nb->slot(op);											\
+		type_error("bad operand type for " op_name ": '%.200s'", op, NULL);	\
+		return NULL;														\
+	} while (0)
+
+CrObject* CrNumber_Negative(CrObject* op)
+{
+	if (CrInt_CheckExact(op))
+		return CrInt_Negate(op);
+	if (CrFloat_CheckExact(op))
+		return CrFloatObject_FromDouble(-((CrFloatObject*)op)->ob_fval);
+	UNARY_OP(op, nb_negative, "unary -");
+}
+
+CrObject* CrNumber_Positive(CrObject* op)
+{
+	UNARY_OP(op, nb_positive, "unary +");
+}
+
+CrObject* CrNumber_Absolute(CrObject* op)
+{
+	UNARY_OP(op, nb_absolute, "abs()");
+}
+
+CrObject* CrNumber_Int(CrObject* op)
+{
+	if (CrInt_CheckExact(op))
+		return CrObject_NEWREF(op);
+	if (CrString_Check(op))
+		return CrIntObject_FromString(((CrStringObject*)op)->ob_svar, 10);
+
+	CrNumberMethods* nb = Cr_TYPE(op)->tp_as_number;
+	if (nb != NULL && nb->nb_int != NULL)
+		return nb->nb_int(op);
+	type_error("int() argument must be a string or a number, not '%.200s'", op, NULL);
+	return NULL;
+}
+
+CrObject* CrNumber_Float(CrObject* op)
+{
+	if (CrFloat_CheckExact(op))
+		return CrObject_NEWREF(op);
+	if (CrString_Check(op))
+		return CrFloatObject_FromString(((CrStringObject*)op)->ob_svar);
+
+	CrNumberMethods* nb = Cr_TYPE(op)->tp_as_number;
+	if (nb != NULL && nb->nb_float != NULL)
+		return nb->nb_float(op);
+	type_error("float() argument must be a string or a number, not '%.200s'", op, NULL);
+	return NULL;
+}
+
+/*
+*
+*		Comparison
+*
+*/
+
+/* a op b is b reflected_op a */
+static const int swapped_op[] = { Cr_GT, Cr_GE, Cr_EQ, Cr_NE, Cr_LT, Cr_LE };
+static const char* const opstrings[] = { "<", "<=", "==", "!=", ">", ">=" };
+
+static CrObject* do_richcompare(CrObject* a, CrObject* b, int op)
+{
+	richcmpfunc f;
+	CrObject* res;
+	int checked_reverse_op = 0;
+
+	if (!Cr_IS_TYPE(b, Cr_TYPE(a)) &&
+		CrType_IsSubtype(Cr_TYPE(b), Cr_TYPE(a)) &&
+		(f = Cr_TYPE(b)->tp_richcompare) != NULL)
+	{
+		checked_reverse_op = 1;
+		res = f(b, a, swapped_op[op]);
+		if (res != Cr_NotImplemented)
+			return res;
+		CrObject_DECREF(res);
+	}
+	if ((f = Cr_TYPE(a)->tp_richcompare) != NULL)
+	{
+		res = f(a, b, op);
+		if (res != Cr_NotImplemented)
+			return res;
+		CrObject_DECREF(res);
+	}
+	if (!checked_reverse_op && (f = Cr_TYPE(b)->tp_richcompare) != NULL)
+	{
+		res = f(b, a, swapped_op[op]);
+		if (res != Cr_NotImplemented)
+			return res;
+		CrObject_DECREF(res);
+	}
+
+	switch (op)
+	{
+	case Cr_EQ:
+		return CrBool_FromLong(a == b);
+	case Cr_NE:
+		return CrBool_FromLong(a != b);
+	default:
+	{
+		char format[96];
+		snprintf(format, sizeof(format), "'%s' not supported between instances of '%%.100s' and '%%.100s'", opstrings[op]);
+		type_error(format, a, b);
+		return NULL;
+	}
+	}
+}
+
+CrObject* CrObject_RichCompare(CrObject* a, CrObject* b, int op)
+{
+	assert(Cr_LT <= op && op <= Cr_GE);
+	if (a == NULL || b == NULL)
+	{
+		if (!CrError_Occurred())
+			CrError_BadInternalCall();
+		return NULL;
+	}
+
+	if (CrInt_CheckExact(a) && CrInt_CheckExact(b))
+	{
+		if (CrInt_IS_SMALL(a) && CrInt_IS_SMALL(b))
+			Cr_RETURN_RICHCOMPARE(CrInt_VALUE(a), CrInt_VALUE(b), op);
+		Cr_RETURN_RICHCOMPARE(CrInt_Compare(a, b), 0, op);
+	}
+	if (CrFloat_CheckExact(a) && CrFloat_CheckExact(b))
+		Cr_RETURN_RICHCOMPARE(((CrFloatObject*)a)->ob_fval, ((CrFloatObject*)b)->ob_fval, op);
+	if (CrString_CheckExact(a) && CrString_CheckExact(b))
+		return _CrString_RichCompare(a, b, op);
+
+	return do_richcompare(a, b, op);
+}
+
+int CrObject_RichCompareBool(CrObject* a, CrObject* b, int op)
+{
+	/* Identity implies equality, even for NaN, like containers expect */
+	if (a == b)
+	{
+		if (op == Cr_EQ)
+			return 1;
+		if (op == Cr_NE)
+			return 0;
+	}
+
+	CrObject* res = CrObject_RichCompare(a, b, op);
+	if (res == NULL)
+		return -1;
+	int ok;
+	if (res == Cr_True)
+		ok = 1;
+	else if (res == Cr_False)
+		ok = 0;
+	else
+		ok = CrObject_IsTrue(res);
+	CrObject_DECREF(res);
+	return ok;
+}
+
+int CrObject_IsTrue(CrObject* op)
+{
+	if (op == Cr_True)
+		return 1;
+	if (op == Cr_False || op == Cr_Null)
+		return 0;
+
+	CrNumberMethods* nb = Cr_TYPE(op)->tp_as_number;
+	if (nb != NULL && nb->nb_bool != NULL)
+		return nb->nb_bool(op);
+	return 1;
+}
+
+/*
+*
+*		Iteration
+*
+*/
+
+CrObject* CrObject_GetIter(CrObject* op)
+{
+	getiterfunc f = Cr_TYPE(op)->tp_iter;
+	if (f == NULL)
+	{
+		type_error("'%.200s' object is not iterable", op, NULL);
+		return NULL;
+	}
+
+	CrObject* res = f(op);
+	if (res != NULL && !CrIter_Check(res))
+	{
+		type_error("iter() returned non-iterator of type '%.100s'", res, NULL);
+		CrObject_DECREF(res);
+		return NULL;
+	}
+	return res;
+}
+
+CrObject* CrIter_Next(CrObject* iter)
+{
+	iternextfunc f = Cr_TYPE(iter)->tp_iternext;
+	if (f == NULL)
+	{
+		type_error("'%.200s' object is not an iterator", iter, NULL);
+		return NULL;
+	}
+	return f(iter);
+}
+
+/*
+*
+*		Attributes and calls
+*
+*/
+
+CrObject* CrObject_GetAttr(CrObject* op, CrObject* name)
+{
+	if (!CrString_Check(name))
+	{
+		type_error("attribute name must be string, not '%.200s'", name, NULL);
+		return NULL;
+	}
+
+	getattrofunc f = Cr_TYPE(op)->tp_getattro;
+	if (f != NULL)
+		return f(op, name);
+
+	char msg[256];
+	snprintf(msg, sizeof(msg), "'%.50s' object has no attribute '%.100s'",
+		Cr_TYPE(op)->tp_name, ((CrStringObject*)name)->ob_svar);
+	CrError_SetString(CrExc_AttributeError, msg);
+	return NULL;
+}
+
+CrObject* CrObject_GetAttrString(CrObject* op, const char* name)
+{
+	CrObject* str = CrString_InternFromString(name);
+	if (str == NULL)
+		return NULL;
+	CrObject* res = CrObject_GetAttr(op, str);
+	CrObject_DECREF(str);
+	return res;
+}
+
+CrObject* CrObject_Call(CrObject* callable, CrObject* args, CrObject* kwargs)
+{
+	ternaryfunc call = Cr_TYPE(callable)->tp_call;
+	if (call == NULL)
+	{
+		type_error("'%.200s' object is not callable", callable, NULL);
+		return NULL;
+	}
+
+	CrObject* result = call(callable, args, kwargs);
+	if (result == NULL && !CrError_Occurred())
+		CrError_SetString(CrExc_SystemError, "NULL result without error in CrObject_Call");
+	return result;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <objects/object.h>
+
+/*
+ * Abstract object interface
+ *
+ * Operations on objects of any type, dispatched through the type slots.
+ * The hot entry points first check for exact built-in types and call the
+ * implementation directly, so int + int or float < float never goes
+ * through a function pointer. Everything else follows Python's rules: a
+ * binary operation asks the left operand's slot first, unless the right
+ * operand's type is a subtype of the left's, and falls back to the other
+ * operand when a slot returns Cr_NotImplemented.
+ *
+ * All functions return a new reference, or NULL with an error set.
+ */
+
+/* Numbers */
+
+CrObject* CrNumber_Add(CrObject* a, CrObject* b);
+CrObject* CrNumber_Subtract(CrObject* a, CrObject* b);
+CrObject* CrNumber_Multiply(CrObject* a, CrObject* b);
+CrObject* CrNumber_Remainder(CrObject* a, CrObject* b);
+CrObject* CrNumber_FloorDivide(CrObject* a, CrObject* b);
+CrObject* CrNumber_TrueDivide(CrObject* a, CrObject* b);
+
+CrObject* CrNumber_Negative(CrObject* op);
+CrObject* CrNumber_Positive(CrObject* op);
+CrObject* CrNumber_Absolute(CrObject* op);
+
+/* int(op) and float(op) */
+CrObject* CrNumber_Int(CrObject* op);
+CrObject* CrNumber_Float(CrObject* op);
+
+/* Comparison */
+
+/* Compare with one of the Cr_LT .. Cr_GE operators. == and != fall back
+   to identity when neither type can compare the operands. */
+CrObject* CrObject_RichCompare(CrObject* a, CrObject* b, int op);
+
+/* Like CrObject_RichCompare() but returns 1 or 0, or -1 with an error set.
+   Identical objects are always equal. */
+int CrObject_RichCompareBool(CrObject* a, CrObject* b, int op);
+
+/* Returns 1 if the object is true, 0 if it is false, -1 on error */
+int CrObject_IsTrue(CrObject* op);
+
+/* Iteration */
+
+#define CrIter_Check(op) (Cr_TYPE(op)->tp_iternext != NULL)
+
+CrObject* CrObject_GetIter(CrObject* op);
+
+/* Return the next item, or NULL without an error set when the iterator is
+   exhausted */
+CrObject* CrIter_Next(CrObject* iter);
+
+/* Attributes and calls */
+
+CrObject* CrObject_GetAttr(CrObject* op, CrObject* name);
+CrObject* CrObject_GetAttrString(CrObject* op, const char* name);
+
+/* 'args' is a list of positional arguments, 'kwargs' a dict or NULL */
+CrObject* CrObject_Call(CrObject* callable, CrObject* args, CrObject* kwargs);
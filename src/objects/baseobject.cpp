@@ -13,8 +13,19 @@ CrTypeObject CrBaseType = {
 	0,										// tp_itemsize
 	TPFLAGS_DEFAULT | TPFLAGS_BASETYPE,		// tp_flags
 	0,										// tp_dealloc
+	CrObject_GenericHash,					// tp_hash
+	0,										// tp_as_number
+	0,										// tp_richcompare
+	0,										// tp_iter
+	0,										// tp_iternext
+	0,										// tp_getattro
+	0,										// tp_call
+	0,										// tp_traverse
+	0,										// tp_clear
 	0,										// tp_base
-	Mem_Free								// tp_free
+	0,										// tp_depth
+	0,										// tp_display
+	Mem_ObjectFree							// tp_free
 };
 
 CrTypeObject CrBaseObjectType = {
@@ -25,6 +36,17 @@ CrTypeObject CrBaseObjectType = {
 	0,										// tp_itemsize
 	TPFLAGS_DEFAULT | TPFLAGS_BASETYPE,		// tp_flags
 	(destructor)object_dealloc,				// tp_dealloc
+	CrObject_GenericHash,					// tp_hash
+	0,										// tp_as_number
+	0,										// tp_richcompare
+	0,										// tp_iter
+	0,										// tp_iternext
+	0,										// tp_getattro
+	0,										// tp_call
+	0,										// tp_traverse
+	0,										// tp_clear
 	0,										// tp_base
-	Mem_Free								// tp_free
+	0,										// tp_depth
+	0,										// tp_display
+	Mem_ObjectFree							// tp_free
 };
\ No newline at end of file
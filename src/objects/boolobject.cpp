@@ -1,5 +1,6 @@
 #include "boolobject.h"
 
+#include <core/hash.h>
 #include <objects/intobject.h>
 
 static CrObject* true_str = NULL;
@@ -10,30 +11,51 @@ static void bool_dealloc(CrObject* self)
 	Cr_TYPE(self)->tp_free(self);
 }
 
-/* The type object for bool.  Note that this cannot be subclassed! */
+/* Bools hash like the ints 0 and 1 */
+static Cr_hash_t bool_hash(CrIntObject* self)
+{
+	return CrHash_Int(self->ob_ival);
+}
+
+/* The type object for bool.  Note that this cannot be subclassed!
+   The numeric and comparison slots are inherited from int. */
 
 CrTypeObject CrBoolType = {
 	VAROBJECT_HEAD_INIT(&CrBoolType, 0)		// base
 	"bool",									// tp_name
 	"Bool object type",						// tp_doc
-	sizeof(CrObject),						// tp_size
+	sizeof(CrIntObject),					// tp_size
 	0,										// tp_itemsize
-	TPFLAGS_DEFAULT | TPFLAGS_BASETYPE,		// tp_flags
+	TPFLAGS_DEFAULT | TPFLAGS_BASETYPE |	// tp_flags
+		TPFLAGS_LONG_SUBCLASS,
 	(destructor)bool_dealloc,				// tp_dealloc
-	0,										// tp_base
-	Mem_Free								// tp_free
+	(hashfunc)bool_hash,					// tp_hash
+	0,										// tp_as_number
+	0,										// tp_richcompare
+	0,										// tp_iter
+	0,										// tp_iternext
+	0,										// tp_getattro
+	0,										// tp_call
+	0,										// tp_traverse
+	0,										// tp_clear
+	&CrIntType,								// tp_base
+	0,										// tp_depth
+	0,										// tp_display
+	Mem_ObjectFree							// tp_free
 };
 
 /* The objects representing bool values False and True */
 
 CrIntObject CrFalseStruct = {
 	VAROBJECT_HEAD_INIT(&CrBoolType, 0)
+	{ 0 },
 	{ 0 }
 };
 
 CrIntObject CrTrueStruct = {
 	VAROBJECT_HEAD_INIT(&CrBoolType, 0)
-	{ 1 }
+	{ 1 },
+	{ 0 }
 };
 
 CrObject* CrBool_FromLong(int b)
@@ -0,0 +1,768 @@
+#include "dictobject.h"
+
+#include <objects/abstract.h>
+#include <objects/baseobject.h>
+#include <objects/boolobject.h>
+#include <objects/floatobject.h>
+#include <objects/intobject.h>
+#include <objects/stringobject.h>
+#include <core/error.h>
+#include <core/gc.h>
+
+/*
+*
+*		Layout
+*
+*/
+
+/* A dict's storage is a single keys object holding the index table
+   followed by the entries:
+
+	+---------------+
+	| dk_size       |
+	| dk_lookup     |
+	| ...           |
+	+---------------+
+	| dk_indices[]  |  dk_size slots of 1, 2, 4 or 8 bytes
+	+---------------+
+	| dk_entries[]  |  USABLE_FRACTION(dk_size) entries
+	+---------------+
+
+   An index slot holds DKIX_EMPTY, DKIX_DUMMY (the entry was deleted) or
+   the position of an entry. Entries are appended in insertion order and
+   deleted entries are left as holes, so iteration order is insertion
+   order. Holes and dummies are only cleaned up the next time the table is
+   resized, which happens when an insertion finds no usable entry left. */
+
+#define DKIX_EMPTY		(-1)
+#define DKIX_DUMMY		(-2)
+#define DKIX_ERROR		(-3)
+
+/* Smallest table size, must be a power of 2 */
+#define CrDict_LOG_MINSIZE	3
+#define CrDict_MINSIZE		(1 << CrDict_LOG_MINSIZE)
+
+#define PERTURB_SHIFT	5
+
+/* At most 2/3 of the table is used before it grows */
+#define USABLE_FRACTION(n) (((n) << 1) / 3)
+
+/* Size to grow to on insertion into a full table. Growing relative to the
+   number of live items (rather than the table size) means a table full of
+   dummies is compacted instead of doubled. */
+#define GROWTH_RATE(d) ((d)->ma_used * 3)
+
+typedef struct _dictkeyentry
+{
+	Cr_hash_t me_hash;
+	CrObject* me_key;
+	CrObject* me_value;				// NULL for a deleted entry
+} CrDictKeyEntry;
+
+typedef Cr_size_t (*dict_lookup_func)(CrDictObject* mp, CrObject* key, Cr_hash_t hash, CrObject** value_addr);
+
+struct _dictkeysobject
+{
+	Cr_uint8_t dk_log2_size;
+	Cr_uint8_t dk_log2_index_bytes;
+
+	/* lookdict_string while every key is an exact string, lookdict once
+	   any other key has been inserted */
+	dict_lookup_func dk_lookup;
+
+	Cr_size_t dk_usable;			// Entries left before the table must grow
+	Cr_size_t dk_nentries;			// Entries used, including holes
+};
+
+#define DK_LOG_SIZE(dk)		((dk)->dk_log2_size)
+#define DK_SIZE(dk)			(((Cr_size_t)1) << DK_LOG_SIZE(dk))
+#define DK_MASK(dk)			(DK_SIZE(dk) - 1)
+#define DK_INDICES(dk)		((char*)((dk) + 1))
+#define DK_ENTRIES(dk)		((CrDictKeyEntry*)(DK_INDICES(dk) + ((size_t)1 << (dk)->dk_log2_index_bytes)))
+
+static Cr_size_t lookdict(CrDictObject* mp, CrObject* key, Cr_hash_t hash, CrObject** value_addr);
+static Cr_size_t lookdict_string(CrDictObject* mp, CrObject* key, Cr_hash_t hash, CrObject** value_addr);
+
+/* Every empty dict shares this keys object until its first insertion, so
+   creating a dict does not allocate a table. Its dk_usable of 0 forces the
+   first insertion to resize. */
+static struct
+{
+	CrDictKeysObject keys;
+	Cr_int8_t indices[CrDict_MINSIZE];
+} empty_keys_struct = {
+	{ CrDict_LOG_MINSIZE, CrDict_LOG_MINSIZE, lookdict_string, 0, 0 },
+	{ DKIX_EMPTY, DKIX_EMPTY, DKIX_EMPTY, DKIX_EMPTY, DKIX_EMPTY, DKIX_EMPTY, DKIX_EMPTY, DKIX_EMPTY }
+};
+
+#define Cr_EMPTY_KEYS (&empty_keys_struct.keys)
+
+/*
+*
+*		Free list
+*
+*/
+
+/* Dead dicts are chained through ob_type. Their table is released
+   before they go on the list. */
+
+#ifndef CrDict_MAXFREELIST
+#define CrDict_MAXFREELIST 80
+#endif
+
+static CrDictObject* free_list = NULL;
+static int numfree = 0;
+static int maxfree = CrDict_MAXFREELIST;
+
+/*
+*
+*		Helper functions
+*
+*/
+
+static inline Cr_size_t dictkeys_get_index(const CrDictKeysObject* keys, Cr_size_t i)
+{
+	int log2_size = DK_LOG_SIZE(keys);
+	if (log2_size < 8)
+		return ((const Cr_int8_t*)DK_INDICES(keys))[i];
+	else if (log2_size < 16)
+		return ((const Cr_int16_t*)DK_INDICES(keys))[i];
+#if SIZE_MAX > 0xffffffffU
+	else if (log2_size >= 32)
+		return ((const Cr_int64_t*)DK_INDICES(keys))[i];
+#endif
+	return ((const Cr_int32_t*)DK_INDICES(keys))[i];
+}
+
+static inline void dictkeys_set_index(CrDictKeysObject* keys, Cr_size_t i, Cr_size_t ix)
+{
+	int log2_size = DK_LOG_SIZE(keys);
+	if (log2_size < 8)
+		((Cr_int8_t*)DK_INDICES(keys))[i] = (Cr_int8_t)ix;
+	else if (log2_size < 16)
+		((Cr_int16_t*)DK_INDICES(keys))[i] = (Cr_int16_t)ix;
+#if SIZE_MAX > 0xffffffffU
+	else if (log2_size >= 32)
+		((Cr_int64_t*)DK_INDICES(keys))[i] = (Cr_int64_t)ix;
+#endif
+	else
+		((Cr_int32_t*)DK_INDICES(keys))[i] = (Cr_int32_t)ix;
+}
+
+static CrDictKeysObject* new_keys_object(Cr_uint8_t log2_size)
+{
+	/* An index slot must be able to hold any entry position, which is
+	   below USABLE_FRACTION(size). */
+	Cr_uint8_t log2_bytes;
+	if (log2_size < 8)
+		log2_bytes = log2_size;
+	else if (log2_size < 16)
+		log2_bytes = log2_size + 1;
+#if SIZE_MAX > 0xffffffffU
+	else if (log2_size >= 32)
+		log2_bytes = log2_size + 3;
+#endif
+	else
+		log2_bytes = log2_size + 2;
+
+	Cr_size_t usable = USABLE_FRACTION((Cr_size_t)1 << log2_size);
+	CrDictKeysObject* dk = (CrDictKeysObject*)Mem_Alloc(sizeof(CrDictKeysObject)
+		+ ((size_t)1 << log2_bytes) + sizeof(CrDictKeyEntry) * usable);
+	if (dk == NULL)
+	{
+		CrError_NoMemory();
+		return NULL;
+	}
+
+	dk->dk_log2_size = log2_size;
+	dk->dk_log2_index_bytes = log2_bytes;
+	dk->dk_lookup = lookdict_string;
+	dk->dk_usable = usable;
+	dk->dk_nentries = 0;
+	memset(DK_INDICES(dk), 0xff, (size_t)1 << log2_bytes);
+	return dk;
+}
+
+static void free_keys_object(CrDictKeysObject* keys)
+{
+	if (keys == Cr_EMPTY_KEYS)
+		return;
+
+	CrDictKeyEntry* entries = DK_ENTRIES(keys);
+	for (Cr_size_t i = 0, n = keys->dk_nentries; i < n; i++)
+	{
+		CrObject_XDECREF(entries[i].me_key);
+		CrObject_XDECREF(entries[i].me_value);
+	}
+	Mem_Free(keys);
+}
+
+static inline int string_equal(CrObject* a, CrObject* b)
+{
+	return Cr_SIZE(a) == Cr_SIZE(b) &&
+		memcmp(((CrStringObject*)a)->ob_svar, ((CrStringObject*)b)->ob_svar, Cr_SIZE(a)) == 0;
+}
+
+/* Bools are ints by value, but only exact ints can be limb ints */
+static int int_equal_double(CrObject* a, double b)
+{
+	if (CrInt_CheckExact(a))
+		return CrInt_EqualsDouble(a, b);
+	return (double)CrInt_VALUE(a) == b;
+}
+
+/* Compare two keys for equality, returns -1 on error. The built-in key
+   types are compared inline, anything else goes through tp_richcompare. */
+static int key_equal(CrObject* a, CrObject* b)
+{
+	if (a == b)
+		return 1;
+
+	if (CrString_CheckExact(a) && CrString_CheckExact(b))
+		return string_equal(a, b);
+
+	int a_int = CrInt_CheckExact(a) || Cr_IS_TYPE(a, &CrBoolType);
+	int b_int = CrInt_CheckExact(b) || Cr_IS_TYPE(b, &CrBoolType);
+	if (a_int && b_int)
+	{
+		if (CrInt_IS_SMALL(a) && CrInt_IS_SMALL(b))
+			return CrInt_VALUE(a) == CrInt_VALUE(b);
+		return CrInt_CheckExact(a) && CrInt_CheckExact(b) && CrInt_Compare(a, b) == 0;
+	}
+	if (a_int && CrFloat_CheckExact(b))
+		return int_equal_double(a, ((CrFloatObject*)b)->ob_fval);
+	if (b_int && CrFloat_CheckExact(a))
+		return int_equal_double(b, ((CrFloatObject*)a)->ob_fval);
+	if (CrFloat_CheckExact(a) && CrFloat_CheckExact(b))
+		return ((CrFloatObject*)a)->ob_fval == ((CrFloatObject*)b)->ob_fval;
+	return CrObject_RichCompareBool(a, b, Cr_EQ);
+}
+
+/* General lookup, returns the entry index of 'key' or DKIX_EMPTY */
+static Cr_size_t lookdict(CrDictObject* mp, CrObject* key, Cr_hash_t hash, CrObject** value_addr)
+{
+	CrDictKeysObject* dk = mp->ma_keys;
+	CrDictKeyEntry* entries = DK_ENTRIES(dk);
+	size_t mask = DK_MASK(dk);
+	size_t perturb = (size_t)hash;
+	size_t i = (size_t)hash & mask;
+
+	for (;;)
+	{
+		Cr_size_t ix = dictkeys_get_index(dk, i);
+		if (ix == DKIX_EMPTY)
+		{
+			*value_addr = NULL;
+			return ix;
+		}
+		if (ix >= 0)
+		{
+			CrDictKeyEntry* ep = &entries[ix];
+			if (ep->me_key == key)
+			{
+				*value_addr = ep->me_value;
+				return ix;
+			}
+			if (ep->me_hash == hash)
+			{
+				int cmp = key_equal(ep->me_key, key);
+				if (cmp < 0)
+				{
+					*value_addr = NULL;
+					return DKIX_ERROR;
+				}
+				if (cmp)
+				{
+					*value_addr = ep->me_value;
+					return ix;
+				}
+			}
+		}
+		perturb >>= PERTURB_SHIFT;
+		i = (i * 5 + perturb + 1) & mask;
+	}
+}
+
+/* Specialised lookup for tables whose keys are all exact strings, the
+   common case for namespaces. Interned keys match on the pointer compare
+   alone. */
+static Cr_size_t lookdict_string(CrDictObject* mp, CrObject* key, Cr_hash_t hash, CrObject** value_addr)
+{
+	if (!CrString_CheckExact(key))
+		return lookdict(mp, key, hash, value_addr);
+
+	CrDictKeysObject* dk = mp->ma_keys;
+	CrDictKeyEntry* entries = DK_ENTRIES(dk);
+	size_t mask = DK_MASK(dk);
+	size_t perturb = (size_t)hash;
+	size_t i = (size_t)hash & mask;
+
+	for (;;)
+	{
+		Cr_size_t ix = dictkeys_get_index(dk, i);
+		if (ix == DKIX_EMPTY)
+		{
+			*value_addr = NULL;
+			return ix;
+		}
+		if (ix >= 0)
+		{
+			CrDictKeyEntry* ep = &entries[ix];
+			if (ep->me_key == key || (ep->me_hash == hash && string_equal(ep->me_key, key)))
+			{
+				*value_addr = ep->me_value;
+				return ix;
+			}
+		}
+		perturb >>= PERTURB_SHIFT;
+		i = (i * 5 + perturb + 1) & mask;
+	}
+}
+
+/* Lookup of a string key by its contents, for _CrDict_GetItemBytes() */
+static Cr_size_t lookdict_bytes(CrDictKeysObject* dk, const char* bytes, Cr_size_t size, Cr_hash_t hash)
+{
+	CrDictKeyEntry* entries = DK_ENTRIES(dk);
+	size_t mask = DK_MASK(dk);
+	size_t perturb = (size_t)hash;
+	size_t i = (size_t)hash & mask;
+
+	for (;;)
+	{
+		Cr_size_t ix = dictkeys_get_index(dk, i);
+		if (ix == DKIX_EMPTY)
+			return ix;
+		if (ix >= 0)
+		{
+			CrObject* key = entries[ix].me_key;
+			if (entries[ix].me_hash == hash && CrString_CheckExact(key) && Cr_SIZE(key) == size &&
+				memcmp(((CrStringObject*)key)->ob_svar, bytes, size) == 0)
+				return ix;
+		}
+		perturb >>= PERTURB_SHIFT;
+		i = (i * 5 + perturb + 1) & mask;
+	}
+}
+
+/* Find the index slot that points at entry 'index' */
+static Cr_size_t lookdict_index(CrDictKeysObject* dk, Cr_hash_t hash, Cr_size_t index)
+{
+	size_t mask = DK_MASK(dk);
+	size_t perturb = (size_t)hash;
+	size_t i = (size_t)hash & mask;
+
+	for (;;)
+	{
+		Cr_size_t ix = dictkeys_get_index(dk, i);
+		if (ix == index)
+			return i;
+		if (ix == DKIX_EMPTY)
+			return DKIX_EMPTY;
+		perturb >>= PERTURB_SHIFT;
+		i = (i * 5 + perturb + 1) & mask;
+	}
+}
+
+/* Find a free index slot for 'hash'. The table must have room. */
+static Cr_size_t find_empty_slot(CrDictKeysObject* dk, Cr_hash_t hash)
+{
+	size_t mask = DK_MASK(dk);
+	size_t perturb = (size_t)hash;
+	size_t i = (size_t)hash & mask;
+
+	Cr_size_t ix = dictkeys_get_index(dk, i);
+	while (ix >= 0)
+	{
+		perturb >>= PERTURB_SHIFT;
+		i = (i * 5 + perturb + 1) & mask;
+		ix = dictkeys_get_index(dk, i);
+	}
+	return i;
+}
+
+/* Rebuild the table with room for at least 'minsize' items, dropping
+   holes and dummies along the way. */
+static int dict_resize(CrDictObject* mp, Cr_size_t minsize)
+{
+	Cr_uint8_t log2_size = CrDict_LOG_MINSIZE;
+	while (USABLE_FRACTION((Cr_size_t)1 << log2_size) < minsize)
+	{
+		if (log2_size >= sizeof(Cr_size_t) * 8 - 2)
+		{
+			CrError_NoMemory();
+			return -1;
+		}
+		log2_size++;
+	}
+
+	CrDictKeysObject* oldkeys = mp->ma_keys;
+	CrDictKeysObject* newkeys = new_keys_object(log2_size);
+	if (newkeys == NULL)
+		return -1;
+	newkeys->dk_lookup = oldkeys->dk_lookup;
+
+	/* Move the live entries over, the references move with them */
+	CrDictKeyEntry* oldentries = DK_ENTRIES(oldkeys);
+	CrDictKeyEntry* newentries = DK_ENTRIES(newkeys);
+	Cr_size_t n = 0;
+	for (Cr_size_t i = 0; i < oldkeys->dk_nentries; i++)
+	{
+		CrDictKeyEntry* ep = &oldentries[i];
+		if (ep->me_value == NULL)
+			continue;
+		newentries[n] = *ep;
+		dictkeys_set_index(newkeys, find_empty_slot(newkeys, ep->me_hash), n);
+		n++;
+	}
+	assert(n == mp->ma_used);
+
+	newkeys->dk_usable -= n;
+	newkeys->dk_nentries = n;
+	mp->ma_keys = newkeys;
+
+	if (oldkeys != Cr_EMPTY_KEYS)
+		Mem_Free(oldkeys);
+	return 0;
+}
+
+static inline Cr_hash_t dict_hash(CrObject* key)
+{
+	if (CrString_CheckExact(key))
+	{
+		Cr_hash_t hash = ((CrStringObject*)key)->ob_shash;
+		if (hash != -1)
+			return hash;
+	}
+	return CrObject_Hash(key);
+}
+
+static int insertdict(CrDictObject* mp, CrObject* key, Cr_hash_t hash, CrObject* value)
+{
+	CrObject* old_value;
+
+	/* The shared empty table is never modified, get a real one first */
+	if (mp->ma_keys == Cr_EMPTY_KEYS && dict_resize(mp, 1) < 0)
+		return -1;
+
+	if (mp->ma_keys->dk_lookup == lookdict_string && !CrString_CheckExact(key))
+		mp->ma_keys->dk_lookup = lookdict;
+
+	Cr_size_t ix = mp->ma_keys->dk_lookup(mp, key, hash, &old_value);
+	if (ix == DKIX_ERROR)
+		return -1;
+
+	if (ix == DKIX_EMPTY)
+	{
+		if (mp->ma_keys->dk_usable <= 0 && dict_resize(mp, GROWTH_RATE(mp)) < 0)
+			return -1;
+
+		CrDictKeysObject* dk = mp->ma_keys;
+		CrDictKeyEntry* ep = &DK_ENTRIES(dk)[dk->dk_nentries];
+		dictkeys_set_index(dk, find_empty_slot(dk, hash), dk->dk_nentries);
+
+		CrObject_INCREF(key);
+		CrObject_INCREF(value);
+		ep->me_hash = hash;
+		ep->me_key = key;
+		ep->me_value = value;
+		mp->ma_used++;
+		dk->dk_usable--;
+		dk->dk_nentries++;
+		return 0;
+	}
+
+	CrObject_INCREF(value);
+	DK_ENTRIES(mp->ma_keys)[ix].me_value = value;
+	CrObject_DECREF(old_value);
+	return 0;
+}
+
+//
+//
+//		Methods
+//
+//
+
+static void dict_dealloc(CrDictObject* self)
+{
+	CrObject_GC_UnTrack(self);
+	CrDictKeysObject* keys = self->ma_keys;
+	self->ma_keys = Cr_EMPTY_KEYS;
+	self->ma_used = 0;
+	free_keys_object(keys);
+
+	if (CrDict_CheckExact(self) && numfree < maxfree)
+	{
+		CrObject_SET_TYPE(self, (CrTypeObject*)free_list);
+		free_list = self;
+		numfree++;
+		return;
+	}
+	Cr_TYPE(self)->tp_free((CrObject*)self);
+}
+
+static int dict_traverse(CrDictObject* self, visitproc visit, void* arg)
+{
+	CrDictKeysObject* dk = self->ma_keys;
+	CrDictKeyEntry* entries = DK_ENTRIES(dk);
+	for (Cr_size_t i = 0, n = dk->dk_nentries; i < n; i++)
+	{
+		Cr_VISIT(entries[i].me_key);
+		Cr_VISIT(entries[i].me_value);
+	}
+	return 0;
+}
+
+CrTypeObject CrDictType = {
+	VAROBJECT_HEAD_INIT(&CrDictType, 0)		// base
+	"dict",									// tp_name
+	"Dictionary object type",				// tp_doc
+	sizeof(CrDictObject),					// tp_size
+	0,										// tp_itemsize
+	TPFLAGS_DEFAULT | TPFLAGS_BASETYPE |	// tp_flags
+		TPFLAGS_HAVE_GC | TPFLAGS_DICT_SUBCLASS,
+	(destructor)dict_dealloc,				// tp_dealloc
+	0,										// tp_hash
+	0,										// tp_as_number
+	0,										// tp_richcompare
+	0,										// tp_iter
+	0,										// tp_iternext
+	0,										// tp_getattro
+	0,										// tp_call
+	(traverseproc)dict_traverse,			// tp_traverse
+	CrDict_Clear,							// tp_clear
+	&CrBaseObjectType,						// tp_base
+	0,										// tp_depth
+	0,										// tp_display
+	CrObject_GC_Del							// tp_free
+};
+
+CrObject* CrDictObject_New()
+{
+	CrDictObject* obj = free_list;
+	if (obj != NULL)
+	{
+		free_list = (CrDictObject*)Cr_TYPE(obj);
+		numfree--;
+		ObjectInit((CrObject*)obj, &CrDictType);
+	}
+	else
+	{
+		obj = CrObject_GC_NEW(CrDictObject, &CrDictType);
+		if (obj == NULL)
+			return NULL;
+	}
+	obj->ma_keys = Cr_EMPTY_KEYS;
+	obj->ma_used = 0;
+	CrObject_GC_Track(obj);
+	return (CrObject*)obj;
+}
+
+CrObject* CrDict_GetItem(CrObject* dict, CrObject* key)
+{
+	if (!CrDict_Check(dict))
+		return NULL;
+
+	Cr_hash_t hash = dict_hash(key);
+	if (hash == -1)
+	{
+		CrError_Clear();
+		return NULL;
+	}
+
+	CrDictObject* mp = (CrDictObject*)dict;
+	CrObject* value;
+	if (mp->ma_keys->dk_lookup(mp, key, hash, &value) == DKIX_ERROR)
+		CrError_Clear();
+	return value;
+}
+
+CrObject* CrDict_GetItemString(CrObject* dict, const char* key)
+{
+	CrObject* kv = CrStringObject_FromString(key);
+	if (kv == NULL)
+	{
+		CrError_Clear();
+		return NULL;
+	}
+	CrObject* rv = CrDict_GetItem(dict, kv);
+	CrObject_DECREF(kv);
+	return rv;
+}
+
+CrObject* _CrDict_GetItemBytes(CrObject* dict, const char* bytes, Cr_size_t size, Cr_hash_t hash)
+{
+	if (!CrDict_Check(dict))
+		return NULL;
+
+	CrDictKeysObject* dk = ((CrDictObject*)dict)->ma_keys;
+	Cr_size_t ix = lookdict_bytes(dk, bytes, size, hash);
+	return ix >= 0 ? DK_ENTRIES(dk)[ix].me_value : NULL;
+}
+
+int CrDict_SetItem(CrObject* dict, CrObject* key, CrObject* value)
+{
+	if (!CrDict_Check(dict))
+	{
+		CrError_BadInternalCall();
+		return -1;
+	}
+	assert(key);
+	assert(value);
+
+	Cr_hash_t hash = dict_hash(key);
+	if (hash == -1)
+		return -1;
+	return insertdict((CrDictObject*)dict, key, hash, value);
+}
+
+int CrDict_SetItemString(CrObject* dict, const char* key, CrObject* value)
+{
+	CrObject* kv = CrStringObject_FromString(key);
+	if (kv == NULL)
+		return -1;
+	int err = CrDict_SetItem(dict, kv, value);
+	CrObject_DECREF(kv);
+	return err;
+}
+
+int CrDict_DelItem(CrObject* dict, CrObject* key)
+{
+	if (!CrDict_Check(dict))
+	{
+		CrError_BadInternalCall();
+		return -1;
+	}
+
+	Cr_hash_t hash = dict_hash(key);
+	if (hash == -1)
+		return -1;
+
+	CrDictObject* mp = (CrDictObject*)dict;
+	CrObject* old_value;
+	Cr_size_t ix = mp->ma_keys->dk_lookup(mp, key, hash, &old_value);
+	if (ix == DKIX_ERROR)
+		return -1;
+	if (ix == DKIX_EMPTY)
+	{
+		CrError_SetString(CrExc_KeyError, "key not found");
+		return -1;
+	}
+
+	/* Leave a dummy in the index and a hole in the entries, both are
+	   cleaned up by the next resize */
+	CrDictKeysObject* dk = mp->ma_keys;
+	CrDictKeyEntry* ep = &DK_ENTRIES(dk)[ix];
+	Cr_size_t hashpos = lookdict_index(dk, hash, ix);
+	assert(hashpos >= 0);
+	dictkeys_set_index(dk, hashpos, DKIX_DUMMY);
+
+	CrObject* old_key = ep->me_key;
+	ep->me_key = NULL;
+	ep->me_value = NULL;
+	mp->ma_used--;
+	CrObject_DECREF(old_key);
+	CrObject_DECREF(old_value);
+	return 0;
+}
+
+int CrDict_Contains(CrObject* dict, CrObject* key)
+{
+	if (!CrDict_Check(dict))
+	{
+		CrError_BadInternalCall();
+		return -1;
+	}
+
+	Cr_hash_t hash = dict_hash(key);
+	if (hash == -1)
+		return -1;
+
+	CrDictObject* mp = (CrDictObject*)dict;
+	CrObject* value;
+	Cr_size_t ix = mp->ma_keys->dk_lookup(mp, key, hash, &value);
+	if (ix == DKIX_ERROR)
+		return -1;
+	return ix != DKIX_EMPTY && value != NULL;
+}
+
+int CrDict_Clear(CrObject* dict)
+{
+	if (!CrDict_Check(dict))
+	{
+		CrError_BadInternalCall();
+		return -1;
+	}
+
+	/* Detach the table first so destructors never see released items */
+	CrDictObject* mp = (CrDictObject*)dict;
+	CrDictKeysObject* keys = mp->ma_keys;
+	mp->ma_keys = Cr_EMPTY_KEYS;
+	mp->ma_used = 0;
+	free_keys_object(keys);
+	return 0;
+}
+
+Cr_size_t CrDict_Size(CrObject* dict)
+{
+	if (!CrDict_Check(dict))
+	{
+		CrError_BadInternalCall();
+		return -1;
+	}
+	return ((CrDictObject*)dict)->ma_used;
+}
+
+int CrDict_Next(CrObject* dict, Cr_size_t* pos, CrObject** key, CrObject** value)
+{
+	if (!CrDict_Check(dict))
+		return 0;
+
+	CrDictKeysObject* dk = ((CrDictObject*)dict)->ma_keys;
+	CrDictKeyEntry* entries = DK_ENTRIES(dk);
+	Cr_size_t i = *pos;
+	while (i < dk->dk_nentries && entries[i].me_value == NULL)
+		i++;
+	if (i >= dk->dk_nentries)
+		return 0;
+
+	*pos = i + 1;
+	if (key)
+		*key = entries[i].me_key;
+	if (value)
+		*value = entries[i].me_value;
+	return 1;
+}
+
+int CrDict_ClearFreeList()
+{
+	int freed = numfree;
+	while (free_list != NULL)
+	{
+		CrDictObject* obj = free_list;
+		free_list = (CrDictObject*)Cr_TYPE(obj);
+		CrDictType.tp_free(obj);
+	}
+	numfree = 0;
+	return freed;
+}
+
+void CrDict_SetFreeListLimit(int limit)
+{
+	maxfree = limit < 0 ? 0 : limit;
+	while (numfree > maxfree)
+	{
+		CrDictObject* obj = free_list;
+		free_list = (CrDictObject*)Cr_TYPE(obj);
+		CrDictType.tp_free(obj);
+		numfree--;
+	}
+}
+
+CrStatus CrDict_InitTypes()
+{
+	if (CrType_Ready(&CrDictType) < 0)
+		return CrStatus_Error("can't init dict type");
+
+	return CrStatus_Ok();
+}
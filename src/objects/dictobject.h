@@ -0,0 +1,60 @@
+#pragma once
+
+#include <objects/object.h>
+#include <core/status.h>
+
+/*
+ * The dict uses the compact layout: entries live in a dense array in
+ * insertion order, and a separate hash table of indices into that array
+ * is probed with open addressing. The index table uses the smallest
+ * integer width (1, 2, 4 or 8 bytes) that can address every entry, so
+ * small dicts stay small. See dictobject.cpp for the details.
+ */
+
+typedef struct _dictkeysobject CrDictKeysObject;
+
+typedef struct _dictobject
+{
+	CrObject_HEAD
+	Cr_size_t ma_used;				// Number of items in the dictionary
+	CrDictKeysObject* ma_keys;
+} CrDictObject;
+
+/* Type object */
+extern CrTypeObject CrDictType;
+
+/* Type check macros */
+#define CrDict_Check(self) CrType_FastSubClass(Cr_TYPE(self), TPFLAGS_DICT_SUBCLASS)
+#define CrDict_CheckExact(self) Cr_IS_TYPE(self, &CrDictType)
+
+CrObject* CrDictObject_New();
+
+/* API Functions */
+
+/* Return a borrowed reference to the value of 'key', or NULL without an
+   error set if it is missing. */
+CrObject* CrDict_GetItem(CrObject* dict, CrObject* key);
+CrObject* CrDict_GetItemString(CrObject* dict, const char* key);
+
+/* Like CrDict_GetItem() for a string key given as 'size' bytes and their
+   CrHash_Bytes() hash, so a string can be looked up without creating it.
+   Only exact string keys match. */
+CrObject* _CrDict_GetItemBytes(CrObject* dict, const char* bytes, Cr_size_t size, Cr_hash_t hash);
+int CrDict_SetItem(CrObject* dict, CrObject* key, CrObject* value);
+int CrDict_SetItemString(CrObject* dict, const char* key, CrObject* value);
+int CrDict_DelItem(CrObject* dict, CrObject* key);
+int CrDict_Contains(CrObject* dict, CrObject* key);
+int CrDict_Clear(CrObject* dict);
+Cr_size_t CrDict_Size(CrObject* dict);
+
+/* Iterate over the items in insertion order. Start with *pos = 0; returns
+   0 when there are no more items. The references are borrowed and the
+   dict must not be resized while iterating. */
+int CrDict_Next(CrObject* dict, Cr_size_t* pos, CrObject** key, CrObject** value);
+
+/* Free list management, returns the number of objects released */
+int CrDict_ClearFreeList();
+void CrDict_SetFreeListLimit(int limit);
+
+/* Runtime lifecycle */
+CrStatus CrDict_InitTypes();
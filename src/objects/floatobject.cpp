@@ -1,14 +1,252 @@
 #include "floatobject.h"
 
+#include <core/ctype.h>
+#include <core/dtoa.h>
+#include <core/error.h>
+#include <core/hash.h>
+#include <objects/boolobject.h>
+#include <objects/intobject.h>
+#include <objects/stringobject.h>
+
+/*
+	Free list
+
+	Works the same way as the int free list, dead objects are chained
+	through ob_type.
+*/
+
+#ifndef CrFloat_MAXFREELIST
+#define CrFloat_MAXFREELIST 100
+#endif
+
+static CrFloatObject* free_list = NULL;
+static int numfree = 0;
+static int maxfree = CrFloat_MAXFREELIST;
+
 /*
 	Methods
 */
 
 static void float_dealloc(CrFloatObject* self)
 {
+	if (CrFloat_CheckExact(self) && numfree < maxfree)
+	{
+		CrObject_SET_TYPE(self, (CrTypeObject*)free_list);
+		free_list = self;
+		numfree++;
+		return;
+	}
 	Cr_TYPE(self)->tp_free((CrObject*)self);
 }
 
+static Cr_hash_t float_hash(CrFloatObject* self)
+{
+	return CrHash_Double(self->ob_fval);
+}
+
+/* Store the value of a float or int operand in *dval. Returns 0 if the
+   operand is neither, -1 with an error set if an int is too large. */
+static int float_convert(CrObject* obj, double* dval)
+{
+	if (CrFloat_Check(obj))
+	{
+		*dval = ((CrFloatObject*)obj)->ob_fval;
+		return 1;
+	}
+	if (!CrInt_Check(obj))
+		return 0;
+
+	if (CrInt_IS_SMALL(obj))
+	{
+		*dval = (double)CrInt_VALUE(obj);
+		return 1;
+	}
+	*dval = CrInt_AsDouble(obj);
+	if (std::isinf(*dval))
+	{
+		CrError_SetString(CrExc_OverflowError, "int too large to convert to float");
+		return -1;
+	}
+	return 1;
+}
+
+#define CONVERT_TO_DOUBLE(obj, dval)						\
+	do {													\
+		int cr_ok = float_convert(obj, &(dval));			\
+		if (cr_ok < 0)										\
+			return NULL;									\
+		if (cr_ok == 0)										\
+			Cr_RETURN_NOTIMPLEMENTED;						\
+	} while (0)
+
+static CrObject* float_add(CrObject* a, CrObject* b)
+{
+	double x, y;
+	CONVERT_TO_DOUBLE(a, x);
+	CONVERT_TO_DOUBLE(b, y);
+	return CrFloatObject_FromDouble(x + y);
+}
+
+static CrObject* float_sub(CrObject* a, CrObject* b)
+{
+	double x, y;
+	CONVERT_TO_DOUBLE(a, x);
+	CONVERT_TO_DOUBLE(b, y);
+	return CrFloatObject_FromDouble(x - y);
+}
+
+static CrObject* float_mul(CrObject* a, CrObject* b)
+{
+	double x, y;
+	CONVERT_TO_DOUBLE(a, x);
+	CONVERT_TO_DOUBLE(b, y);
+	return CrFloatObject_FromDouble(x * y);
+}
+
+static CrObject* float_true_div(CrObject* a, CrObject* b)
+{
+	double x, y;
+	CONVERT_TO_DOUBLE(a, x);
+	CONVERT_TO_DOUBLE(b, y);
+	if (y == 0.0)
+	{
+		CrError_SetString(CrExc_ZeroDivisionError, "float division by zero");
+		return NULL;
+	}
+	return CrFloatObject_FromDouble(x / y);
+}
+
+/* Python's divmod for floats, y must be nonzero. The remainder takes the
+   sign of y and the quotient is rounded to the nearest integral value. */
+static void float_divmod(double x, double y, double* floordiv, double* mod)
+{
+	double m = fmod(x, y);
+	double div = (x - m) / y;
+	if (m != 0.0)
+	{
+		if ((y < 0) != (m < 0))
+		{
+			m += y;
+			div -= 1.0;
+		}
+	}
+	else
+		m = copysign(0.0, y);
+
+	if (div != 0.0)
+	{
+		*floordiv = floor(div);
+		if (div - *floordiv > 0.5)
+			*floordiv += 1.0;
+	}
+	else
+		*floordiv = copysign(0.0, x / y);
+	*mod = m;
+}
+
+static CrObject* float_floor_div(CrObject* a, CrObject* b)
+{
+	double x, y, div, mod;
+	CONVERT_TO_DOUBLE(a, x);
+	CONVERT_TO_DOUBLE(b, y);
+	if (y == 0.0)
+	{
+		CrError_SetString(CrExc_ZeroDivisionError, "float floor division by zero");
+		return NULL;
+	}
+	float_divmod(x, y, &div, &mod);
+	return CrFloatObject_FromDouble(div);
+}
+
+static CrObject* float_mod(CrObject* a, CrObject* b)
+{
+	double x, y, div, mod;
+	CONVERT_TO_DOUBLE(a, x);
+	CONVERT_TO_DOUBLE(b, y);
+	if (y == 0.0)
+	{
+		CrError_SetString(CrExc_ZeroDivisionError, "float modulo by zero");
+		return NULL;
+	}
+	float_divmod(x, y, &div, &mod);
+	return CrFloatObject_FromDouble(mod);
+}
+
+static CrObject* float_neg(CrFloatObject* self)
+{
+	return CrFloatObject_FromDouble(-self->ob_fval);
+}
+
+static CrObject* float_pos(CrFloatObject* self)
+{
+	if (CrFloat_CheckExact(self))
+		return CrObject_NEWREF(self);
+	return CrFloatObject_FromDouble(self->ob_fval);
+}
+
+static CrObject* float_abs(CrFloatObject* self)
+{
+	return CrFloatObject_FromDouble(fabs(self->ob_fval));
+}
+
+static int float_bool(CrFloatObject* self)
+{
+	return self->ob_fval != 0.0;
+}
+
+static CrObject* float_int(CrFloatObject* self)
+{
+	return CrIntObject_FromDouble(self->ob_fval);
+}
+
+/* Ints are compared exactly, not by rounding them to a double */
+static CrObject* float_richcompare(CrObject* a, CrObject* b, int op)
+{
+	if (!CrFloat_Check(a))
+		Cr_RETURN_NOTIMPLEMENTED;
+
+	double x = ((CrFloatObject*)a)->ob_fval;
+	if (CrFloat_Check(b))
+		Cr_RETURN_RICHCOMPARE(x, ((CrFloatObject*)b)->ob_fval, op);
+	if (!CrInt_Check(b))
+		Cr_RETURN_NOTIMPLEMENTED;
+
+	/* NaN compares unequal to everything, infinities are beyond any int */
+	if (!std::isfinite(x))
+		Cr_RETURN_RICHCOMPARE(x, 0.0, op);
+
+	const Cr_int64_t exact = (Cr_int64_t)1 << 53;
+	if (CrInt_IS_SMALL(b) && -exact <= CrInt_VALUE(b) && CrInt_VALUE(b) <= exact)
+		Cr_RETURN_RICHCOMPARE(x, (double)CrInt_VALUE(b), op);
+
+	/* Compare the integral part as an int, the fraction breaks a tie */
+	double whole = trunc(x);
+	double frac = x - whole;
+	CrObject* w = CrIntObject_FromDouble(whole);
+	if (w == NULL)
+		return NULL;
+	int c = CrInt_Compare(w, b);
+	CrObject_DECREF(w);
+	if (c == 0)
+		c = frac > 0.0 ? 1 : frac < 0.0 ? -1 : 0;
+	Cr_RETURN_RICHCOMPARE(c, 0, op);
+}
+
+static CrNumberMethods float_as_number = {
+	float_add,								// nb_add
+	float_sub,								// nb_subtract
+	float_mul,								// nb_multiply
+	float_mod,								// nb_remainder
+	float_floor_div,						// nb_floor_divide
+	float_true_div,							// nb_true_divide
+	(unaryfunc)float_neg,					// nb_negative
+	(unaryfunc)float_pos,					// nb_positive
+	(unaryfunc)float_abs,					// nb_absolute
+	(inquiry)float_bool,					// nb_bool
+	(unaryfunc)float_int,					// nb_int
+	(unaryfunc)float_pos					// nb_float
+};
+
 CrTypeObject CrFloatType = {
 	VAROBJECT_HEAD_INIT(&CrFloatType, 0)	// base
 	"float",								// tp_name
@@ -17,17 +255,94 @@ CrTypeObject CrFloatType = {
 	0,										// tp_itemsize
 	TPFLAGS_DEFAULT | TPFLAGS_BASETYPE,		// tp_flags
 	(destructor)float_dealloc,				// tp_dealloc
+	(hashfunc)float_hash,					// tp_hash
+	&float_as_number,						// tp_as_number
+	float_richcompare,						// tp_richcompare
+	0,										// tp_iter
+	0,										// tp_iternext
+	0,										// tp_getattro
+	0,										// tp_call
+	0,										// tp_traverse
+	0,										// tp_clear
 	0,										// tp_base
-	Mem_Free								// tp_free
+	0,										// tp_depth
+	0,										// tp_display
+	Mem_ObjectFree							// tp_free
 };
 
 CrObject* CrFloatObject_FromDouble(double dval)
 {
-	CrFloatObject* obj = CrObject_NEW(CrFloatObject, &CrFloatType);
+	CrFloatObject* obj = free_list;
+	if (obj != NULL)
+	{
+		free_list = (CrFloatObject*)Cr_TYPE(obj);
+		numfree--;
+		ObjectInit((CrObject*)obj, &CrFloatType);
+	}
+	else
+	{
+		obj = CrObject_NEW(CrFloatObject, &CrFloatType);
+		if (obj == NULL)
+			return NULL;
+	}
 	obj->ob_fval = dval;
 	return (CrObject*)obj;
 }
 
+CrObject* CrFloatObject_FromString(const char* str)
+{
+	const char* s = str;
+	while (Cr_ISSPACE(*s))
+		s++;
+
+	const char* end;
+	double dval = Cr_StringToDouble(s, &end);
+	if (end != s)
+	{
+		while (Cr_ISSPACE(*end))
+			end++;
+	}
+	if (end == s || *end != '\0')
+	{
+		CrError_SetString(CrExc_ValueError, "could not convert string to float");
+		return NULL;
+	}
+	return CrFloatObject_FromDouble(dval);
+}
+
+CrObject* CrFloat_Repr(CrObject* op)
+{
+	assert(CrFloat_Check(op));
+	char buf[Cr_DTOA_BUFSIZE];
+	int len = Cr_DoubleToString(((CrFloatObject*)op)->ob_fval, buf);
+	return CrStringObject_FromStringAndSize(buf, len);
+}
+
+int CrFloat_ClearFreeList()
+{
+	int freed = numfree;
+	while (free_list != NULL)
+	{
+		CrFloatObject* obj = free_list;
+		free_list = (CrFloatObject*)Cr_TYPE(obj);
+		CrFloatType.tp_free(obj);
+	}
+	numfree = 0;
+	return freed;
+}
+
+void CrFloat_SetFreeListLimit(int limit)
+{
+	maxfree = limit < 0 ? 0 : limit;
+	while (numfree > maxfree)
+	{
+		CrFloatObject* obj = free_list;
+		free_list = (CrFloatObject*)Cr_TYPE(obj);
+		CrFloatType.tp_free(obj);
+		numfree--;
+	}
+}
+
 CrStatus CrFloat_InitTypes()
 {
 	if (CrType_Ready(&CrFloatType) < 0)
@@ -12,8 +12,25 @@ typedef struct _floatobject
 
 extern CrTypeObject CrFloatType;
 
+/* Type check macros */
+#define CrFloat_Check(self) CrObject_TypeCheck(self, &CrFloatType)
+#define CrFloat_CheckExact(self) Cr_IS_TYPE(self, &CrFloatType)
+
 /* Convert a C++ double to a CrFloatObject */
 CrObject* CrFloatObject_FromDouble(double dval);
 
+/* Parse a float literal, surrounding whitespace is allowed. Sets
+   ValueError and returns NULL if 'str' is not a float. */
+CrObject* CrFloatObject_FromString(const char* str);
+
+/* API Functions */
+
+/* The shortest string that reads back as the same float */
+CrObject* CrFloat_Repr(CrObject* op);
+
+/* Free list management, returns the number of objects released */
+int CrFloat_ClearFreeList();
+void CrFloat_SetFreeListLimit(int limit);
+
 /* Runtime lifecycle */
 CrStatus CrFloat_InitTypes();
\ No newline at end of file
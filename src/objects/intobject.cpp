@@ -1,38 +1,1482 @@
 #include "intobject.h"
 
+#include <core/error.h>
+#include <core/hash.h>
+#include <objects/boolobject.h>
+#include <objects/floatobject.h>
+#include <objects/stringobject.h>
+
+#include <climits>
+#include <vector>
+
+/*
+	Free list
+
+	Dead int objects are kept on a singly-linked list threaded through
+	ob_type and handed out again by the constructors, so creating and
+	dropping temporaries does not hit the allocator. Only inline ints are
+	kept, limb ints vary in size.
+*/
+
+#ifndef CrInt_MAXFREELIST
+#define CrInt_MAXFREELIST 100
+#endif
+
+static CrIntObject* free_list = NULL;
+static int numfree = 0;
+static int maxfree = CrInt_MAXFREELIST;
+
+static CrIntObject* int_alloc()
+{
+	CrIntObject* obj = free_list;
+	if (obj != NULL)
+	{
+		free_list = (CrIntObject*)Cr_TYPE(obj);
+		numfree--;
+		ObjectInit((CrObject*)obj, &CrIntType);
+		return obj;
+	}
+	obj = CrObject_NEW(CrIntObject, &CrIntType);
+	if (obj != NULL)
+		VAROBJECT_SET_SIZE(obj, 0);
+	return obj;
+}
+
+/*
+	Small int cache
+
+	The cached objects live in static storage and are immortal, so handing
+	them out never writes to them.
+*/
+
+#define NSMALLINTS (CR_NSMALLNEGINTS + CR_NSMALLPOSINTS)
+#define IS_SMALL_INT(ival) (-CR_NSMALLNEGINTS <= (ival) && (ival) < CR_NSMALLPOSINTS)
+
+static CrIntObject small_ints[NSMALLINTS];
+static int small_ints_ready = 0;
+
+static inline CrObject* get_small_int(Cr_int64_t ival)
+{
+	CrObject* obj = (CrObject*)&small_ints[ival + CR_NSMALLNEGINTS];
+	CrObject_INCREF(obj);
+	return obj;
+}
+
+static void init_small_ints()
+{
+	for (int i = 0; i < NSMALLINTS; i++)
+	{
+		CrIntObject* obj = &small_ints[i];
+		ObjectInit((CrObject*)obj, &CrIntType);
+		CrObject_SET_IMMORTAL(obj);
+		VAROBJECT_SET_SIZE(obj, 0);
+		obj->ob_ival = i - CR_NSMALLNEGINTS;
+	}
+	small_ints_ready = 1;
+}
+
+/*
+	Inline arithmetic
+
+	Overflow checked 64-bit operations for the fast path. On overflow the
+	operation is redone on limbs.
+*/
+
+static inline int add_overflow(Cr_int64_t a, Cr_int64_t b, Cr_int64_t* r)
+{
+#if defined(__GNUC__) || defined(__clang__)
+	return __builtin_add_overflow(a, b, r);
+#else
+	*r = (Cr_int64_t)((Cr_uint64_t)a + (Cr_uint64_t)b);
+	return ((a ^ *r) & (b ^ *r)) < 0;
+#endif
+}
+
+static inline int sub_overflow(Cr_int64_t a, Cr_int64_t b, Cr_int64_t* r)
+{
+#if defined(__GNUC__) || defined(__clang__)
+	return __builtin_sub_overflow(a, b, r);
+#else
+	*r = (Cr_int64_t)((Cr_uint64_t)a - (Cr_uint64_t)b);
+	return ((a ^ b) & (a ^ *r)) < 0;
+#endif
+}
+
+static inline int mul_overflow(Cr_int64_t a, Cr_int64_t b, Cr_int64_t* r)
+{
+#if defined(__GNUC__) || defined(__clang__)
+	return __builtin_mul_overflow(a, b, r);
+#else
+	if (a == 0 || b == 0)
+	{
+		*r = 0;
+		return 0;
+	}
+	int negative = (a < 0) != (b < 0);
+	Cr_uint64_t ua = a < 0 ? 0 - (Cr_uint64_t)a : (Cr_uint64_t)a;
+	Cr_uint64_t ub = b < 0 ? 0 - (Cr_uint64_t)b : (Cr_uint64_t)b;
+	Cr_uint64_t limit = (Cr_uint64_t)INT64_MAX + negative;
+	if (ua > limit / ub)
+		return 1;
+	Cr_uint64_t p = ua * ub;
+	*r = negative ? (Cr_int64_t)(0 - p) : (Cr_int64_t)p;
+	return 0;
+#endif
+}
+
+/*
+	Magnitudes
+
+	The limb routines work on unsigned magnitudes stored least significant
+	limb first. Inputs may carry leading zero limbs unless noted otherwise;
+	the callers normalize results before building objects.
+*/
+
+typedef std::vector<crdigit> digits_t;
+
+/* Below this many limbs schoolbook multiplication beats Karatsuba */
+#ifndef CrInt_KARATSUBA_CUTOFF
+#define CrInt_KARATSUBA_CUTOFF 48
+#endif
+
+static inline Cr_size_t mag_size(const crdigit* a, Cr_size_t n)
+{
+	while (n > 0 && a[n - 1] == 0)
+		n--;
+	return n;
+}
+
+static inline void mag_normalize(digits_t& a)
+{
+	while (!a.empty() && a.back() == 0)
+		a.pop_back();
+}
+
+/* Compare two normalized magnitudes */
+static int mag_compare(const crdigit* a, Cr_size_t na, const crdigit* b, Cr_size_t nb)
+{
+	if (na != nb)
+		return na < nb ? -1 : 1;
+	for (Cr_size_t i = na - 1; i >= 0; i--)
+	{
+		if (a[i] != b[i])
+			return a[i] < b[i] ? -1 : 1;
+	}
+	return 0;
+}
+
+/* out = a + b, out has room for max(na, nb) + 1 limbs. Returns the number
+   of limbs written. */
+static Cr_size_t mag_add(const crdigit* a, Cr_size_t na, const crdigit* b, Cr_size_t nb, crdigit* out)
+{
+	if (na < nb)
+	{
+		std::swap(a, b);
+		std::swap(na, nb);
+	}
+
+	crtwodigits carry = 0;
+	Cr_size_t i = 0;
+	for (; i < nb; i++)
+	{
+		carry += (crtwodigits)a[i] + b[i];
+		out[i] = (crdigit)carry;
+		carry >>= CrInt_SHIFT;
+	}
+	for (; i < na; i++)
+	{
+		carry += a[i];
+		out[i] = (crdigit)carry;
+		carry >>= CrInt_SHIFT;
+	}
+	out[i] = (crdigit)carry;
+	return na + 1;
+}
+
+/* out = a - b where a >= b, out has room for na limbs */
+static void mag_sub(const crdigit* a, Cr_size_t na, const crdigit* b, Cr_size_t nb, crdigit* out)
+{
+	crtwodigits borrow = 0;
+	Cr_size_t i = 0;
+	for (; i < nb; i++)
+	{
+		crtwodigits d = (crtwodigits)a[i] - b[i] - borrow;
+		out[i] = (crdigit)d;
+		borrow = (d >> CrInt_SHIFT) & 1;
+	}
+	for (; i < na; i++)
+	{
+		crtwodigits d = (crtwodigits)a[i] - borrow;
+		out[i] = (crdigit)d;
+		borrow = (d >> CrInt_SHIFT) & 1;
+	}
+	assert(borrow == 0);
+}
+
+/* a[0:na] += b[0:nb], the sum must fit in na limbs */
+static void mag_add_into(crdigit* a, Cr_size_t na, const crdigit* b, Cr_size_t nb)
+{
+	crtwodigits carry = 0;
+	Cr_size_t i = 0;
+	for (; i < nb; i++)
+	{
+		carry += (crtwodigits)a[i] + b[i];
+		a[i] = (crdigit)carry;
+		carry >>= CrInt_SHIFT;
+	}
+	for (; carry && i < na; i++)
+	{
+		carry += a[i];
+		a[i] = (crdigit)carry;
+		carry >>= CrInt_SHIFT;
+	}
+	assert(carry == 0);
+}
+
+/* a[0:na] -= b[0:nb], the difference must not be negative */
+static void mag_sub_into(crdigit* a, Cr_size_t na, const crdigit* b, Cr_size_t nb)
+{
+	crtwodigits borrow = 0;
+	Cr_size_t i = 0;
+	for (; i < nb; i++)
+	{
+		crtwodigits d = (crtwodigits)a[i] - b[i] - borrow;
+		a[i] = (crdigit)d;
+		borrow = (d >> CrInt_SHIFT) & 1;
+	}
+	for (; borrow && i < na; i++)
+	{
+		crtwodigits d = (crtwodigits)a[i] - borrow;
+		a[i] = (crdigit)d;
+		borrow = (d >> CrInt_SHIFT) & 1;
+	}
+	assert(borrow == 0);
+}
+
+/* out[0:na+nb] = a * b */
+static void mag_mul_school(const crdigit* a, Cr_size_t na, const crdigit* b, Cr_size_t nb, crdigit* out)
+{
+	memset(out, 0, (na + nb) * sizeof(crdigit));
+	for (Cr_size_t i = 0; i < na; i++)
+	{
+		crtwodigits ai = a[i];
+		if (ai == 0)
+			continue;
+
+		crtwodigits carry = 0;
+		crdigit* p = out + i;
+		for (Cr_size_t j = 0; j < nb; j++)
+		{
+			carry += ai * b[j] + p[j];
+			p[j] = (crdigit)carry;
+			carry >>= CrInt_SHIFT;
+		}
+		p[nb] = (crdigit)carry;
+	}
+}
+
+static void mag_mul(const crdigit* a, Cr_size_t na, const crdigit* b, Cr_size_t nb, crdigit* out);
+
+/* Multiply when a is at least twice as long as b. Splitting a into slices
+   the size of b keeps each product balanced enough for Karatsuba. */
+static void mag_mul_lopsided(const crdigit* a, Cr_size_t na, const crdigit* b, Cr_size_t nb, crdigit* out)
+{
+	memset(out, 0, (na + nb) * sizeof(crdigit));
+	digits_t tmp(2 * nb);
+	for (Cr_size_t off = 0; off < na; off += nb)
+	{
+		Cr_size_t len = na - off < nb ? na - off : nb;
+		mag_mul(a + off, len, b, nb, tmp.data());
+		mag_add_into(out + off, na + nb - off, tmp.data(), len + nb);
+	}
+}
+
+/*
+	Karatsuba multiplication
+
+	With a = ah*B**h + al and b = bh*B**h + bl,
+
+		a*b = z2*B**2h + z1*B**h + z0
+
+	where z0 = al*bl, z2 = ah*bh and z1 = (al + ah)*(bl + bh) - z0 - z2, so
+	three half size products replace four.
+*/
+static void mag_mul_karatsuba(const crdigit* a, Cr_size_t na, const crdigit* b, Cr_size_t nb, crdigit* out)
+{
+	assert(nb <= na && na < 2 * nb);
+	Cr_size_t h = nb >> 1;
+	Cr_size_t nout = na + nb;
+
+	/* z0 goes into out[0:2h] and z2 into out[2h:], they don't overlap */
+	mag_mul(a, h, b, h, out);
+	mag_mul(a + h, na - h, b + h, nb - h, out + 2 * h);
+
+	digits_t sa(na - h + 1), sb(nb - h + 1);
+	Cr_size_t nsa = mag_add(a + h, na - h, a, h, sa.data());
+	Cr_size_t nsb = mag_add(b + h, nb - h, b, h, sb.data());
+	nsa = mag_size(sa.data(), nsa);
+	nsb = mag_size(sb.data(), nsb);
+
+	Cr_size_t nz1 = nsa + nsb;
+	digits_t z1(nz1 > nout - 2 * h ? nz1 : nout - 2 * h, 0);
+	if (nsa > 0 && nsb > 0)
+	{
+		if (nsa >= nsb)
+			mag_mul(sa.data(), nsa, sb.data(), nsb, z1.data());
+		else
+			mag_mul(sb.data(), nsb, sa.data(), nsa, z1.data());
+	}
+	nz1 = (Cr_size_t)z1.size();
+
+	mag_sub_into(z1.data(), nz1, out, 2 * h);
+	mag_sub_into(z1.data(), nz1, out + 2 * h, nout - 2 * h);
+	mag_add_into(out + h, nout - h, z1.data(), mag_size(z1.data(), nz1));
+}
+
+/* out[0:na+nb] = a * b, out must not overlap the inputs */
+static void mag_mul(const crdigit* a, Cr_size_t na, const crdigit* b, Cr_size_t nb, crdigit* out)
+{
+	if (na < nb)
+	{
+		std::swap(a, b);
+		std::swap(na, nb);
+	}
+
+	if (nb < CrInt_KARATSUBA_CUTOFF)
+		mag_mul_school(a, na, b, nb, out);
+	else if (na >= 2 * nb)
+		mag_mul_lopsided(a, na, b, nb, out);
+	else
+		mag_mul_karatsuba(a, na, b, nb, out);
+}
+
+/* a = a * m + add, in place */
+static void mag_mul_1_add(digits_t& a, crdigit m, crdigit add)
+{
+	crtwodigits carry = add;
+	for (size_t i = 0; i < a.size(); i++)
+	{
+		carry += (crtwodigits)a[i] * m;
+		a[i] = (crdigit)carry;
+		carry >>= CrInt_SHIFT;
+	}
+	if (carry)
+		a.push_back((crdigit)carry);
+}
+
+/* a = a / d in place, returns the remainder */
+static crdigit mag_divrem_1(crdigit* a, Cr_size_t n, crdigit d)
+{
+	crtwodigits rem = 0;
+	for (Cr_size_t i = n - 1; i >= 0; i--)
+	{
+		rem = (rem << CrInt_SHIFT) | a[i];
+		a[i] = (crdigit)(rem / d);
+		rem %= d;
+	}
+	return (crdigit)rem;
+}
+
+static int leading_zeros(crdigit x)
+{
+	int n = 0;
+	while (!(x & 0x80000000U))
+	{
+		x <<= 1;
+		n++;
+	}
+	return n;
+}
+
+/*
+	Long division (Knuth, TAOCP vol. 2, 4.3.1, algorithm D)
+
+	Divides u[0:m] by the normalized v[0:n], n >= 2 and m >= n, leaving
+	m - n + 1 quotient limbs in q and n remainder limbs in r.
+*/
+static void mag_divrem_knuth(const crdigit* u, Cr_size_t m, const crdigit* v, Cr_size_t n, crdigit* q, crdigit* r)
+{
+	assert(n >= 2 && m >= n && v[n - 1] != 0);
+
+	/* D1: shift both so the divisor's top bit is set */
+	int s = leading_zeros(v[n - 1]);
+	digits_t vn(n), un(m + 1);
+	for (Cr_size_t i = n - 1; i > 0; i--)
+		vn[i] = (crdigit)((v[i] << s) | ((crtwodigits)v[i - 1] >> (CrInt_SHIFT - s)));
+	vn[0] = v[0] << s;
+	un[m] = (crdigit)((crtwodigits)u[m - 1] >> (CrInt_SHIFT - s));
+	for (Cr_size_t i = m - 1; i > 0; i--)
+		un[i] = (crdigit)((u[i] << s) | ((crtwodigits)u[i - 1] >> (CrInt_SHIFT - s)));
+	un[0] = u[0] << s;
+
+	crtwodigits vtop = vn[n - 1], vnext = vn[n - 2];
+	for (Cr_size_t j = m - n; j >= 0; j--)
+	{
+		/* D3: estimate the quotient limb, off by at most one after this */
+		crtwodigits num = ((crtwodigits)un[j + n] << CrInt_SHIFT) | un[j + n - 1];
+		crtwodigits qhat = num / vtop;
+		crtwodigits rhat = num - qhat * vtop;
+		while (qhat >= CrInt_BASE || qhat * vnext > ((rhat << CrInt_SHIFT) | un[j + n - 2]))
+		{
+			qhat--;
+			rhat += vtop;
+			if (rhat >= CrInt_BASE)
+				break;
+		}
+
+		/* D4: multiply and subtract */
+		Cr_int64_t borrow = 0, t;
+		for (Cr_size_t i = 0; i < n; i++)
+		{
+			crtwodigits p = qhat * vn[i];
+			t = (Cr_int64_t)un[i + j] - borrow - (Cr_int64_t)(p & CrInt_MASK);
+			un[i + j] = (crdigit)t;
+			borrow = (Cr_int64_t)(p >> CrInt_SHIFT) - (t >> CrInt_SHIFT);
+		}
+		t = (Cr_int64_t)un[j + n] - borrow;
+		un[j + n] = (crdigit)t;
+
+		/* D5, D6: the estimate was one too large, add the divisor back */
+		if (t < 0)
+		{
+			qhat--;
+			crtwodigits carry = 0;
+			for (Cr_size_t i = 0; i < n; i++)
+			{
+				carry += (crtwodigits)un[i + j] + vn[i];
+				un[i + j] = (crdigit)carry;
+				carry >>= CrInt_SHIFT;
+			}
+			un[j + n] += (crdigit)carry;
+		}
+		q[j] = (crdigit)qhat;
+	}
+
+	/* D8: unnormalize the remainder */
+	for (Cr_size_t i = 0; i < n; i++)
+		r[i] = (crdigit)((un[i] >> s) | ((crtwodigits)un[i + 1] << (CrInt_SHIFT - s)));
+}
+
+/* a << shift as a new magnitude */
+static digits_t mag_lshift(const crdigit* a, Cr_size_t n, Cr_size_t shift)
+{
+	Cr_size_t limbs = shift / CrInt_SHIFT;
+	int bits = (int)(shift % CrInt_SHIFT);
+	digits_t out(limbs + n + 1, 0);
+	for (Cr_size_t i = 0; i < n; i++)
+	{
+		crtwodigits d = (crtwodigits)a[i] << bits;
+		out[limbs + i] |= (crdigit)d;
+		out[limbs + i + 1] = (crdigit)(d >> CrInt_SHIFT);
+	}
+	mag_normalize(out);
+	return out;
+}
+
+/* Number of significant bits in a normalized magnitude */
+static Cr_size_t mag_bit_length(const crdigit* a, Cr_size_t n)
+{
+	if (n == 0)
+		return 0;
+	return n * CrInt_SHIFT - leading_zeros(a[n - 1]);
+}
+
+/* q, r = divmod(u, v) for normalized magnitudes, v nonzero */
+static void mag_divrem(const crdigit* u, Cr_size_t nu, const crdigit* v, Cr_size_t nv, digits_t& q, digits_t& r)
+{
+	assert(nv > 0);
+	if (mag_compare(u, nu, v, nv) < 0)
+	{
+		q.clear();
+		r.assign(u, u + nu);
+		return;
+	}
+
+	if (nv == 1)
+	{
+		q.assign(u, u + nu);
+		crdigit rem = mag_divrem_1(q.data(), nu, v[0]);
+		r.assign(1, rem);
+	}
+	else
+	{
+		q.assign(nu - nv + 1, 0);
+		r.assign(nv, 0);
+		mag_divrem_knuth(u, nu, v, nv, q.data(), r.data());
+	}
+	mag_normalize(q);
+	mag_normalize(r);
+}
+
+/*
+	Objects and magnitudes
+*/
+
+/* Borrow the magnitude of an int. Inline values are split into the two
+   limb buffer 'buf'. Returns the sign of the value. */
+static int int_magnitude(CrObject* op, crdigit buf[2], const crdigit** digits, Cr_size_t* n)
+{
+	if (CrInt_IS_SMALL(op))
+	{
+		Cr_int64_t v = CrInt_VALUE(op);
+		Cr_uint64_t u = v < 0 ? 0 - (Cr_uint64_t)v : (Cr_uint64_t)v;
+		buf[0] = (crdigit)u;
+		buf[1] = (crdigit)(u >> CrInt_SHIFT);
+		*digits = buf;
+		*n = mag_size(buf, 2);
+		return v < 0 ? -1 : v > 0;
+	}
+
+	Cr_size_t size = Cr_SIZE(op);
+	*digits = ((CrIntObject*)op)->ob_digit;
+	*n = size < 0 ? -size : size;
+	return size < 0 ? -1 : 1;
+}
+
+/* Build an int from a sign and magnitude, inline if it fits */
+static CrObject* int_from_magnitude(int sign, const crdigit* digits, Cr_size_t n)
+{
+	n = mag_size(digits, n);
+	if (n <= 2)
+	{
+		Cr_uint64_t u = 0;
+		if (n > 0)
+			u = digits[0];
+		if (n > 1)
+			u |= (Cr_uint64_t)digits[1] << CrInt_SHIFT;
+
+		if (u <= (Cr_uint64_t)INT64_MAX + (sign < 0))
+			return CrIntObject_FromLongLong(sign < 0 ? (Cr_int64_t)(0 - u) : (Cr_int64_t)u);
+	}
+
+	CrIntObject* obj = (CrIntObject*)Object_NewVar(&CrIntType, n);
+	if (obj == NULL)
+	{
+		CrError_NoMemory();
+		return NULL;
+	}
+	VAROBJECT_SET_SIZE(obj, sign < 0 ? -n : n);
+	obj->ob_ival = 0;
+	memcpy(obj->ob_digit, digits, n * sizeof(crdigit));
+	return (CrObject*)obj;
+}
+
 /*
 	Methods
 */
 
 static void int_dealloc(CrIntObject* self)
 {
+	assert(self < small_ints || self >= small_ints + NSMALLINTS);
+	if (CrInt_CheckExact(self) && Cr_SIZE(self) == 0 && numfree < maxfree)
+	{
+		CrObject_SET_TYPE(self, (CrTypeObject*)free_list);
+		free_list = self;
+		numfree++;
+		return;
+	}
 	Cr_TYPE(self)->tp_free((CrObject*)self);
 }
 
+/* Limb ints are reduced modulo CrHash_MODULUS 16 bits at a time, so they
+   hash like the equal inline int or float would. Multiplying by 2**16 is a
+   rotation of the CrHash_BITS bit residue, since 2**CrHash_BITS is 1. */
+static Cr_hash_t int_hash(CrObject* self)
+{
+	if (CrInt_IS_SMALL(self))
+		return CrHash_Int(CrInt_VALUE(self));
+
+	Cr_size_t size = Cr_SIZE(self);
+	Cr_size_t n = size < 0 ? -size : size;
+	const crdigit* digits = ((CrIntObject*)self)->ob_digit;
+
+	size_t x = 0;
+	for (Cr_size_t i = n - 1; i >= 0; i--)
+	{
+		for (int shift = 16; shift >= 0; shift -= 16)
+		{
+			x = ((x << 16) & CrHash_MODULUS) | (x >> (CrHash_BITS - 16));
+			x += (digits[i] >> shift) & 0xffff;
+			if (x >= CrHash_MODULUS)
+				x -= CrHash_MODULUS;
+		}
+	}
+
+	Cr_hash_t h = size < 0 ? -(Cr_hash_t)x : (Cr_hash_t)x;
+	if (h == -1)
+		h = -2;
+	return h;
+}
+
+/* The number slots are shared with bool, so anything that can be a bool
+   returns a plain int through int_exact() */
+
+#define CHECK_BINOP(a, b)									\
+	do {													\
+		if (!CrInt_Check(a) || !CrInt_Check(b))				\
+			Cr_RETURN_NOTIMPLEMENTED;						\
+	} while (0)
+
+static CrObject* int_exact(CrObject* self)
+{
+	if (CrInt_CheckExact(self))
+		return CrObject_NEWREF(self);
+	return CrIntObject_FromLongLong(CrInt_VALUE(self));
+}
+
+static CrObject* int_add(CrObject* a, CrObject* b)
+{
+	CHECK_BINOP(a, b);
+	return CrInt_Add(a, b);
+}
+
+static CrObject* int_sub(CrObject* a, CrObject* b)
+{
+	CHECK_BINOP(a, b);
+	return CrInt_Subtract(a, b);
+}
+
+static CrObject* int_mul(CrObject* a, CrObject* b)
+{
+	CHECK_BINOP(a, b);
+	return CrInt_Multiply(a, b);
+}
+
+static CrObject* int_mod(CrObject* a, CrObject* b)
+{
+	CHECK_BINOP(a, b);
+	return CrInt_Remainder(a, b);
+}
+
+static CrObject* int_floor_div(CrObject* a, CrObject* b)
+{
+	CHECK_BINOP(a, b);
+	return CrInt_FloorDivide(a, b);
+}
+
+static CrObject* int_true_div(CrObject* a, CrObject* b)
+{
+	CHECK_BINOP(a, b);
+	return CrInt_TrueDivide(a, b);
+}
+
+static CrObject* int_neg(CrObject* self)
+{
+	return CrInt_Negate(self);
+}
+
+static CrObject* int_abs(CrObject* self)
+{
+	if (CrInt_IS_SMALL(self) ? CrInt_VALUE(self) < 0 : Cr_SIZE(self) < 0)
+		return CrInt_Negate(self);
+	return int_exact(self);
+}
+
+static int int_bool(CrObject* self)
+{
+	return !CrInt_IS_SMALL(self) || CrInt_VALUE(self) != 0;
+}
+
+static CrObject* int_float(CrObject* self)
+{
+	double x = CrInt_AsDouble(self);
+	if (std::isinf(x))
+	{
+		CrError_SetString(CrExc_OverflowError, "int too large to convert to float");
+		return NULL;
+	}
+	return CrFloatObject_FromDouble(x);
+}
+
+static CrObject* int_richcompare(CrObject* a, CrObject* b, int op)
+{
+	CHECK_BINOP(a, b);
+	Cr_RETURN_RICHCOMPARE(CrInt_Compare(a, b), 0, op);
+}
+
+static CrNumberMethods int_as_number = {
+	int_add,								// nb_add
+	int_sub,								// nb_subtract
+	int_mul,								// nb_multiply
+	int_mod,								// nb_remainder
+	int_floor_div,							// nb_floor_divide
+	int_true_div,							// nb_true_divide
+	int_neg,								// nb_negative
+	int_exact,								// nb_positive
+	int_abs,								// nb_absolute
+	int_bool,								// nb_bool
+	int_exact,								// nb_int
+	int_float								// nb_float
+};
+
 CrTypeObject CrIntType = {
 	VAROBJECT_HEAD_INIT(&CrIntType, 0)		// base
 	"int",									// tp_name
 	"Integer object type",					// tp_doc
 	sizeof(CrIntObject),					// tp_size
-	0,										// tp_itemsize
-	TPFLAGS_DEFAULT | TPFLAGS_BASETYPE,		// tp_flags
+	sizeof(crdigit),						// tp_itemsize
+	TPFLAGS_DEFAULT | TPFLAGS_BASETYPE |	// tp_flags
+		TPFLAGS_LONG_SUBCLASS,
 	(destructor)int_dealloc,				// tp_dealloc
+	int_hash,								// tp_hash
+	&int_as_number,							// tp_as_number
+	int_richcompare,						// tp_richcompare
+	0,										// tp_iter
+	0,										// tp_iternext
+	0,										// tp_getattro
+	0,										// tp_call
+	0,										// tp_traverse
+	0,										// tp_clear
 	0,										// tp_base
-	Mem_Free								// tp_free
+	0,										// tp_depth
+	0,										// tp_display
+	Mem_ObjectFree							// tp_free
 };
 
 CrObject* CrIntObject_FromInt(Cr_int32_t ival)
 {
-	CrIntObject* obj = CrObject_NEW(CrIntObject, &CrIntType);
+	return CrIntObject_FromLongLong(ival);
+}
+
+CrObject* CrIntObject_FromLongLong(Cr_int64_t ival)
+{
+#ifdef Cr_TAGGED_INTS
+	if (CrTaggedInt_MIN <= ival && ival <= CrTaggedInt_MAX)
+		return CrTaggedInt_FromValue(ival);
+#endif
+	if (IS_SMALL_INT(ival) && small_ints_ready)
+		return get_small_int(ival);
+
+	CrIntObject* obj = int_alloc();
+	if (obj == NULL)
+		return NULL;
 	obj->ob_ival = ival;
 	return (CrObject*)obj;
 }
 
+/* Truncates towards zero like int(x) */
+CrObject* CrIntObject_FromDouble(double dval)
+{
+	if (std::isnan(dval))
+	{
+		CrError_SetString(CrExc_ValueError, "cannot convert float NaN to integer");
+		return NULL;
+	}
+	if (std::isinf(dval))
+	{
+		CrError_SetString(CrExc_ValueError, "cannot convert float infinity to integer");
+		return NULL;
+	}
+	if (-9223372036854775808.0 <= dval && dval < 9223372036854775808.0)
+		return CrIntObject_FromLongLong((Cr_int64_t)dval);
+
+	/* |dval| = mant * 2**(e - 64), with all 53 bits of mantissa in mant */
+	int e;
+	double m = frexp(fabs(dval), &e);
+	Cr_uint64_t mant = (Cr_uint64_t)ldexp(m, 64);
+	int shift = e - 64;
+	int limbs = shift / CrInt_SHIFT, bits = shift % CrInt_SHIFT;
+
+	digits_t digits(limbs + 3, 0);
+	digits[limbs] = (crdigit)(mant << bits);
+	digits[limbs + 1] = (crdigit)(mant >> (CrInt_SHIFT - bits));
+	if (bits)
+		digits[limbs + 2] = (crdigit)(mant >> (64 - bits));
+	return int_from_magnitude(dval < 0 ? -1 : 1, digits.data(), (Cr_size_t)digits.size());
+}
+
+Cr_int64_t CrInt_AsLongLong(CrObject* op, int* overflow)
+{
+	assert(CrInt_Check(op));
+	*overflow = 0;
+	if (CrInt_IS_SMALL(op))
+		return CrInt_VALUE(op);
+
+	*overflow = Cr_SIZE(op) < 0 ? -1 : 1;
+	return -1;
+}
+
+/* Limb ints are correctly rounded, values beyond the double range give
+   infinity. The top 64 bits are converted with the last one set if any
+   bit below them is, which makes the single rounding to 53 bits exact. */
+double CrInt_AsDouble(CrObject* op)
+{
+	assert(CrInt_Check(op));
+	if (CrInt_IS_SMALL(op))
+		return (double)CrInt_VALUE(op);
+
+	crdigit buf[2];
+	const crdigit* digits;
+	Cr_size_t n;
+	int sign = int_magnitude(op, buf, &digits, &n);
+
+	/* Values from 2**63 up to 2**64 only need two limbs */
+	Cr_uint64_t top = ((Cr_uint64_t)digits[n - 1] << CrInt_SHIFT) | digits[n - 2];
+	if (n == 2)
+		return sign < 0 ? -(double)top : (double)top;
+
+	int lz = leading_zeros(digits[n - 1]);
+	Cr_uint64_t bits = top << lz;
+	if (lz)
+		bits |= digits[n - 3] >> (CrInt_SHIFT - lz);
+
+	int sticky = (crdigit)(digits[n - 3] << lz) != 0;
+	for (Cr_size_t i = n - 4; i >= 0 && !sticky; i--)
+		sticky = digits[i] != 0;
+
+	Cr_size_t exp = (n - 2) * CrInt_SHIFT - lz;
+	double x = ldexp((double)(bits | sticky), exp > INT_MAX ? INT_MAX : (int)exp);
+	return sign < 0 ? -x : x;
+}
+
+/* a + b, or a - b with 'negate' set, on magnitudes */
+static CrObject* int_add_slow(CrObject* a, CrObject* b, int negate)
+{
+	crdigit abuf[2], bbuf[2];
+	const crdigit* ad, * bd;
+	Cr_size_t na, nb;
+	int sa = int_magnitude(a, abuf, &ad, &na);
+	int sb = int_magnitude(b, bbuf, &bd, &nb);
+	if (negate)
+		sb = -sb;
+
+	if (sa == 0)
+		return int_from_magnitude(sb, bd, nb);
+	if (sb == 0)
+		return int_from_magnitude(sa, ad, na);
+
+	if (sa == sb)
+	{
+		digits_t out((na > nb ? na : nb) + 1);
+		Cr_size_t n = mag_add(ad, na, bd, nb, out.data());
+		return int_from_magnitude(sa, out.data(), n);
+	}
+
+	int c = mag_compare(ad, na, bd, nb);
+	if (c == 0)
+		return CrIntObject_FromLongLong(0);
+	if (c < 0)
+	{
+		std::swap(ad, bd);
+		std::swap(na, nb);
+		sa = sb;
+	}
+	digits_t out(na);
+	mag_sub(ad, na, bd, nb, out.data());
+	return int_from_magnitude(sa, out.data(), na);
+}
+
+CrObject* CrInt_Add(CrObject* a, CrObject* b)
+{
+	assert(CrInt_Check(a) && CrInt_Check(b));
+	if (CrInt_IS_SMALL(a) && CrInt_IS_SMALL(b))
+	{
+		Cr_int64_t r;
+		if (!add_overflow(CrInt_VALUE(a), CrInt_VALUE(b), &r))
+			return CrIntObject_FromLongLong(r);
+	}
+	return int_add_slow(a, b, 0);
+}
+
+CrObject* CrInt_Subtract(CrObject* a, CrObject* b)
+{
+	assert(CrInt_Check(a) && CrInt_Check(b));
+	if (CrInt_IS_SMALL(a) && CrInt_IS_SMALL(b))
+	{
+		Cr_int64_t r;
+		if (!sub_overflow(CrInt_VALUE(a), CrInt_VALUE(b), &r))
+			return CrIntObject_FromLongLong(r);
+	}
+	return int_add_slow(a, b, 1);
+}
+
+CrObject* CrInt_Multiply(CrObject* a, CrObject* b)
+{
+	assert(CrInt_Check(a) && CrInt_Check(b));
+	if (CrInt_IS_SMALL(a) && CrInt_IS_SMALL(b))
+	{
+		Cr_int64_t r;
+		if (!mul_overflow(CrInt_VALUE(a), CrInt_VALUE(b), &r))
+			return CrIntObject_FromLongLong(r);
+	}
+
+	crdigit abuf[2], bbuf[2];
+	const crdigit* ad, * bd;
+	Cr_size_t na, nb;
+	int sa = int_magnitude(a, abuf, &ad, &na);
+	int sb = int_magnitude(b, bbuf, &bd, &nb);
+	if (sa == 0 || sb == 0)
+		return CrIntObject_FromLongLong(0);
+
+	digits_t out(na + nb);
+	mag_mul(ad, na, bd, nb, out.data());
+	return int_from_magnitude(sa * sb, out.data(), na + nb);
+}
+
+CrObject* CrInt_Negate(CrObject* op)
+{
+	assert(CrInt_Check(op));
+	if (CrInt_IS_SMALL(op) && CrInt_VALUE(op) != INT64_MIN)
+		return CrIntObject_FromLongLong(-CrInt_VALUE(op));
+
+	crdigit buf[2];
+	const crdigit* digits;
+	Cr_size_t n;
+	int sign = int_magnitude(op, buf, &digits, &n);
+	return int_from_magnitude(-sign, digits, n);
+}
+
+/* Floor division and modulo with the sign of the remainder following the
+   divisor, like Python. Either result pointer may be NULL. */
+static int int_divmod(CrObject* a, CrObject* b, CrObject** pq, CrObject** pr)
+{
+	if (CrInt_IS_SMALL(b) && CrInt_VALUE(b) == 0)
+	{
+		CrError_SetString(CrExc_ZeroDivisionError, "integer division or modulo by zero");
+		return -1;
+	}
+
+	if (CrInt_IS_SMALL(a) && CrInt_IS_SMALL(b) &&
+		!(CrInt_VALUE(a) == INT64_MIN && CrInt_VALUE(b) == -1))
+	{
+		Cr_int64_t va = CrInt_VALUE(a), vb = CrInt_VALUE(b);
+		Cr_int64_t q = va / vb, r = va % vb;
+		if (r != 0 && (r < 0) != (vb < 0))
+		{
+			q--;
+			r += vb;
+		}
+		if (pq != NULL && (*pq = CrIntObject_FromLongLong(q)) == NULL)
+			return -1;
+		if (pr != NULL && (*pr = CrIntObject_FromLongLong(r)) == NULL)
+		{
+			if (pq != NULL)
+				CrObject_DECREF(*pq);
+			return -1;
+		}
+		return 0;
+	}
+
+	crdigit abuf[2], bbuf[2];
+	const crdigit* ad, * bd;
+	Cr_size_t na, nb;
+	int sa = int_magnitude(a, abuf, &ad, &na);
+	int sb = int_magnitude(b, bbuf, &bd, &nb);
+
+	digits_t q, r;
+	if (sa != 0)
+		mag_divrem(ad, na, bd, nb, q, r);
+
+	/* Truncation rounded towards zero, floor needs one more when the signs
+	   differ and the division wasn't exact */
+	if (sa * sb < 0 && !r.empty())
+	{
+		crdigit one = 1;
+		digits_t q1(q.size() + 2);
+		mag_add(q.data(), (Cr_size_t)q.size(), &one, 1, q1.data());
+		q.swap(q1);
+		digits_t r1(nb);
+		mag_sub(bd, nb, r.data(), (Cr_size_t)r.size(), r1.data());
+		r.swap(r1);
+	}
+
+	if (pq != NULL && (*pq = int_from_magnitude(sa * sb, q.data(), (Cr_size_t)q.size())) == NULL)
+		return -1;
+	if (pr != NULL && (*pr = int_from_magnitude(sb, r.data(), (Cr_size_t)r.size())) == NULL)
+	{
+		if (pq != NULL)
+			CrObject_DECREF(*pq);
+		return -1;
+	}
+	return 0;
+}
+
+CrObject* CrInt_FloorDivide(CrObject* a, CrObject* b)
+{
+	assert(CrInt_Check(a) && CrInt_Check(b));
+	CrObject* q;
+	if (int_divmod(a, b, &q, NULL) < 0)
+		return NULL;
+	return q;
+}
+
+CrObject* CrInt_Remainder(CrObject* a, CrObject* b)
+{
+	assert(CrInt_Check(a) && CrInt_Check(b));
+	CrObject* r;
+	if (int_divmod(a, b, NULL, &r) < 0)
+		return NULL;
+	return r;
+}
+
+/* Correctly rounded. The quotient is scaled to 63 or 64 bits and its last
+   bit is set if the division was inexact, so converting it to a double
+   rounds the same way the exact quotient would. */
+CrObject* CrInt_TrueDivide(CrObject* a, CrObject* b)
+{
+	assert(CrInt_Check(a) && CrInt_Check(b));
+	const Cr_int64_t exact = (Cr_int64_t)1 << 53;
+	if (CrInt_IS_SMALL(a) && CrInt_IS_SMALL(b))
+	{
+		Cr_int64_t va = CrInt_VALUE(a), vb = CrInt_VALUE(b);
+		if (vb == 0)
+		{
+			CrError_SetString(CrExc_ZeroDivisionError, "division by zero");
+			return NULL;
+		}
+		if (-exact <= va && va <= exact && -exact <= vb && vb <= exact)
+			return CrFloatObject_FromDouble((double)va / (double)vb);
+	}
+
+	crdigit abuf[2], bbuf[2];
+	const crdigit* ad, * bd;
+	Cr_size_t na, nb;
+	int sa = int_magnitude(a, abuf, &ad, &na);
+	int sb = int_magnitude(b, bbuf, &bd, &nb);
+	if (sb == 0)
+	{
+		CrError_SetString(CrExc_ZeroDivisionError, "division by zero");
+		return NULL;
+	}
+	if (sa == 0)
+		return CrFloatObject_FromDouble(sb < 0 ? -0.0 : 0.0);
+
+	/* a * 2**k / b lands in [2**62, 2**64) */
+	Cr_size_t k = 63 - (mag_bit_length(ad, na) - mag_bit_length(bd, nb));
+	digits_t u, v, q, r;
+	if (k >= 0)
+	{
+		u = mag_lshift(ad, na, k);
+		v.assign(bd, bd + nb);
+	}
+	else
+	{
+		u.assign(ad, ad + na);
+		v = mag_lshift(bd, nb, -k);
+	}
+	mag_divrem(u.data(), (Cr_size_t)u.size(), v.data(), (Cr_size_t)v.size(), q, r);
+
+	Cr_uint64_t bits = q[0];
+	if (q.size() > 1)
+		bits |= (Cr_uint64_t)q[1] << CrInt_SHIFT;
+	if (!r.empty())
+		bits |= 1;
+
+	double x = ldexp((double)bits, k > INT_MAX ? INT_MIN : k < -INT_MAX ? INT_MAX : (int)-k);
+	if (std::isinf(x))
+	{
+		CrError_SetString(CrExc_OverflowError, "integer division result too large for a float");
+		return NULL;
+	}
+	return CrFloatObject_FromDouble(sa * sb < 0 ? -x : x);
+}
+
+int CrInt_Compare(CrObject* a, CrObject* b)
+{
+	assert(CrInt_Check(a) && CrInt_Check(b));
+	if (CrInt_IS_SMALL(a) && CrInt_IS_SMALL(b))
+	{
+		Cr_int64_t va = CrInt_VALUE(a), vb = CrInt_VALUE(b);
+		return va < vb ? -1 : va > vb;
+	}
+
+	crdigit abuf[2], bbuf[2];
+	const crdigit* ad, * bd;
+	Cr_size_t na, nb;
+	int sa = int_magnitude(a, abuf, &ad, &na);
+	int sb = int_magnitude(b, bbuf, &bd, &nb);
+	if (sa != sb)
+		return sa < sb ? -1 : 1;
+
+	int c = mag_compare(ad, na, bd, nb);
+	return sa < 0 ? -c : c;
+}
+
+int CrInt_EqualsDouble(CrObject* op, double dval)
+{
+	assert(CrInt_Check(op));
+	if (!std::isfinite(dval) || dval != floor(dval))
+		return 0;
+
+	if (CrInt_IS_SMALL(op))
+	{
+		if (dval < -9223372036854775808.0 || dval >= 9223372036854775808.0)
+			return 0;
+		return (Cr_int64_t)dval == CrInt_VALUE(op);
+	}
+
+	CrObject* other = CrIntObject_FromDouble(dval);
+	if (other == NULL)
+	{
+		CrError_Clear();
+		return 0;
+	}
+	int equal = CrInt_Compare(op, other) == 0;
+	CrObject_DECREF(other);
+	return equal;
+}
+
+/*
+	Base conversion
+
+	Power of two bases map straight onto the limb bits. Decimal uses the
+	powers 10**(9 * 2**k): a literal is split in half at such a power and the
+	halves are converted recursively and joined with a single Karatsuba
+	multiply, and formatting divides by the powers in the same way, so the
+	long operands are only ever handled by the subquadratic routines. Below
+	DEC_LEAF_DIGITS digits (DEC_LEAF_LIMBS limbs) plain 9 digit at a time
+	conversion is quicker.
+*/
+
+#define DEC_CHUNK			1000000000U
+#define DEC_CHUNK_DIGITS	9
+#define DEC_LEAF_DIGITS		(DEC_CHUNK_DIGITS * 32)
+#define DEC_LEAF_LIMBS		32
+
+typedef std::vector<digits_t> powers_t;
+
+/* Extend pows so that it holds 10**(9 * 2**k) for k <= level */
+static void dec_powers(powers_t& pows, int level)
+{
+	if (pows.empty())
+		pows.push_back(digits_t(1, DEC_CHUNK));
+	while ((int)pows.size() <= level)
+	{
+		const digits_t& p = pows.back();
+		digits_t sq(2 * p.size());
+		mag_mul(p.data(), (Cr_size_t)p.size(), p.data(), (Cr_size_t)p.size(), sq.data());
+		mag_normalize(sq);
+		pows.push_back(std::move(sq));
+	}
+}
+
+/* Magnitude of the decimal digit values v[0:len] */
+static digits_t dec_to_mag(const Cr_uint8_t* v, Cr_size_t len, powers_t& pows)
+{
+	digits_t out;
+	if (len <= DEC_LEAF_DIGITS)
+	{
+		Cr_size_t i = 0;
+		Cr_size_t head = len % DEC_CHUNK_DIGITS;
+		if (head == 0)
+			head = DEC_CHUNK_DIGITS;
+		while (i < len)
+		{
+			crdigit chunk = 0, scale = 1;
+			for (Cr_size_t end = i + head; i < end; i++)
+			{
+				chunk = chunk * 10 + v[i];
+				scale *= 10;
+			}
+			mag_mul_1_add(out, scale, chunk);
+			head = DEC_CHUNK_DIGITS;
+		}
+		mag_normalize(out);
+		return out;
+	}
+
+	/* The low part gets the largest 9 * 2**k digits below len */
+	int level = 0;
+	while (((Cr_size_t)DEC_CHUNK_DIGITS << (level + 1)) < len)
+		level++;
+	Cr_size_t nlow = (Cr_size_t)DEC_CHUNK_DIGITS << level;
+	dec_powers(pows, level);
+
+	digits_t hi = dec_to_mag(v, len - nlow, pows);
+	digits_t lo = dec_to_mag(v + len - nlow, nlow, pows);
+	const digits_t& p = pows[level];
+	if (hi.empty())
+		return lo;
+
+	out.assign(hi.size() + p.size() + 1, 0);
+	mag_mul(hi.data(), (Cr_size_t)hi.size(), p.data(), (Cr_size_t)p.size(), out.data());
+	mag_add_into(out.data(), (Cr_size_t)out.size(), lo.data(), (Cr_size_t)lo.size());
+	mag_normalize(out);
+	return out;
+}
+
+/* Magnitude of the digit values v[0:len] in a base that is not a power of
+   two, converted as many digits at a time as fit in a limb */
+static digits_t base_to_mag(const Cr_uint8_t* v, Cr_size_t len, int base)
+{
+	crdigit chunk_max = (crdigit)(CrInt_MASK / base);
+	digits_t out;
+	Cr_size_t i = 0;
+	while (i < len)
+	{
+		crdigit chunk = 0, scale = 1;
+		for (; i < len && scale <= chunk_max; i++)
+		{
+			chunk = chunk * base + v[i];
+			scale *= base;
+		}
+		mag_mul_1_add(out, scale, chunk);
+	}
+	mag_normalize(out);
+	return out;
+}
+
+/* Magnitude of the digit values v[0:len] in base 2**bits */
+static digits_t pow2_to_mag(const Cr_uint8_t* v, Cr_size_t len, int bits)
+{
+	digits_t out((len * bits + CrInt_SHIFT - 1) / CrInt_SHIFT, 0);
+	Cr_size_t pos = 0;
+	for (Cr_size_t i = len - 1; i >= 0; i--, pos += bits)
+	{
+		crtwodigits d = (crtwodigits)v[i] << (pos % CrInt_SHIFT);
+		out[pos / CrInt_SHIFT] |= (crdigit)d;
+		if (d >> CrInt_SHIFT)
+			out[pos / CrInt_SHIFT + 1] |= (crdigit)(d >> CrInt_SHIFT);
+	}
+	mag_normalize(out);
+	return out;
+}
+
+static int digit_value(char c)
+{
+	if ('0' <= c && c <= '9')
+		return c - '0';
+	if ('a' <= c && c <= 'z')
+		return c - 'a' + 10;
+	if ('A' <= c && c <= 'Z')
+		return c - 'A' + 10;
+	return 99;
+}
+
 CrObject* CrIntObject_FromString(const char* str, int base)
 {
-	CrIntObject* obj = CrObject_NEW(CrIntObject, &CrIntType);
-	obj->ob_ival = std::stoi(str, nullptr, base);
-	return (CrObject*)obj;
+	if ((base != 0 && base < 2) || base > 36)
+	{
+		CrError_SetString(CrExc_ValueError, "int() base must be >= 2 and <= 36, or 0");
+		return NULL;
+	}
+
+	const char* s = str;
+	while (isspace((unsigned char)*s))
+		s++;
+
+	int sign = 1;
+	if (*s == '+' || *s == '-')
+	{
+		if (*s == '-')
+			sign = -1;
+		s++;
+	}
+
+	int prefix = 0;
+	if (s[0] == '0')
+	{
+		char c = (char)tolower((unsigned char)s[1]);
+		int prefix_base = c == 'x' ? 16 : c == 'o' ? 8 : c == 'b' ? 2 : 0;
+		if (prefix_base != 0 && (base == 0 || base == prefix_base))
+		{
+			base = prefix_base;
+			prefix = 1;
+			s += 2;
+		}
+	}
+	if (base == 0)
+		base = 10;
+
+	/* Collect the digit values, an underscore may separate digits or
+	   follow the prefix */
+	std::vector<Cr_uint8_t> values;
+	int underscore = 0;
+	for (; *s; s++)
+	{
+		if (*s == '_')
+		{
+			if (underscore || (values.empty() && !prefix))
+				goto invalid;
+			underscore = 1;
+			continue;
+		}
+		int d = digit_value(*s);
+		if (d >= base)
+			break;
+		values.push_back((Cr_uint8_t)d);
+		underscore = 0;
+	}
+	if (underscore || values.empty())
+		goto invalid;
+	while (isspace((unsigned char)*s))
+		s++;
+	if (*s != '\0')
+		goto invalid;
+
+	{
+		Cr_size_t len = (Cr_size_t)values.size();
+		const Cr_uint8_t* v = values.data();
+		while (len > 1 && *v == 0)
+		{
+			v++;
+			len--;
+		}
+
+		/* Fits in 64 bits, no limbs needed */
+		if (len * log2(base) < 63)
+		{
+			Cr_int64_t x = 0;
+			for (Cr_size_t i = 0; i < len; i++)
+				x = x * base + v[i];
+			return CrIntObject_FromLongLong(sign * x);
+		}
+
+		digits_t mag;
+		if ((base & (base - 1)) == 0)
+		{
+			int bits = 0;
+			while ((1 << bits) < base)
+				bits++;
+			mag = pow2_to_mag(v, len, bits);
+		}
+		else if (base == 10)
+		{
+			powers_t pows;
+			mag = dec_to_mag(v, len, pows);
+		}
+		else
+			mag = base_to_mag(v, len, base);
+		return int_from_magnitude(sign, mag.data(), (Cr_size_t)mag.size());
+	}
+
+invalid:
+	CrError_SetString(CrExc_ValueError, "invalid literal for int()");
+	return NULL;
+}
+
+/* Write the decimal digits of a[0:n] at *out. With 'width' zero the digits
+   are written without leading zeros, otherwise they are zero padded to
+   exactly 'width' digits. Requires a < pows[level]**2. */
+static void mag_to_dec(const crdigit* a, Cr_size_t n, int level, Cr_size_t width, const powers_t& pows, char** out)
+{
+	n = mag_size(a, n);
+	if (level < 0 || n <= DEC_LEAF_LIMBS)
+	{
+		digits_t t(a, a + n);
+		std::vector<crdigit> chunks;
+		while (!t.empty())
+		{
+			chunks.push_back(mag_divrem_1(t.data(), (Cr_size_t)t.size(), DEC_CHUNK));
+			mag_normalize(t);
+		}
+
+		char* p = *out;
+		Cr_size_t i = (Cr_size_t)chunks.size() - 1;
+		if (width == 0)
+		{
+			if (chunks.empty())
+				*p++ = '0';
+			else
+				p += sprintf(p, "%u", chunks[i--]);
+		}
+		else
+		{
+			Cr_size_t pad = width - DEC_CHUNK_DIGITS * (Cr_size_t)chunks.size();
+			memset(p, '0', pad);
+			p += pad;
+		}
+		for (; i >= 0; i--)
+			p += sprintf(p, "%09u", chunks[i]);
+		*out = p;
+		return;
+	}
+
+	const digits_t& pow = pows[level];
+	digits_t q, r;
+	mag_divrem(a, n, pow.data(), (Cr_size_t)pow.size(), q, r);
+
+	Cr_size_t nlow = (Cr_size_t)DEC_CHUNK_DIGITS << level;
+	if (width == 0 && q.empty())
+	{
+		mag_to_dec(r.data(), (Cr_size_t)r.size(), level - 1, 0, pows, out);
+		return;
+	}
+	mag_to_dec(q.data(), (Cr_size_t)q.size(), level - 1, width ? width - nlow : 0, pows, out);
+	mag_to_dec(r.data(), (Cr_size_t)r.size(), level - 1, nlow, pows, out);
+}
+
+CrObject* CrInt_Format(CrObject* op, int base)
+{
+	assert(CrInt_Check(op));
+	if (base != 2 && base != 8 && base != 10 && base != 16)
+	{
+		CrError_SetString(CrExc_ValueError, "int format base must be 2, 8, 10 or 16");
+		return NULL;
+	}
+
+	crdigit buf[2];
+	const crdigit* digits;
+	Cr_size_t n;
+	int sign = int_magnitude(op, buf, &digits, &n);
+
+	std::vector<char> text;
+	if (base == 10)
+	{
+		/* 32 bits is a little under 10 decimal digits */
+		text.resize(n * 10 + 2 + DEC_CHUNK_DIGITS);
+		char* p = text.data();
+		if (sign < 0)
+			*p++ = '-';
+
+		powers_t pows;
+		int level = -1;
+		if (n > DEC_LEAF_LIMBS)
+		{
+			/* Go up until pows[level]**2 exceeds the value */
+			level = 0;
+			dec_powers(pows, 0);
+			while (2 * ((Cr_size_t)pows[level].size() - 1) < n)
+				dec_powers(pows, ++level);
+		}
+		mag_to_dec(digits, n, level, 0, pows, &p);
+		return CrStringObject_FromStringAndSize(text.data(), p - text.data());
+	}
+
+	int bits = base == 2 ? 1 : base == 8 ? 3 : 4;
+	Cr_size_t total = n * CrInt_SHIFT;
+	text.resize(total / bits + 3);
+	char* end = text.data() + text.size();
+	char* p = end;
+	for (Cr_size_t pos = 0; pos < total; pos += bits)
+	{
+		crtwodigits d = digits[pos / CrInt_SHIFT] >> (pos % CrInt_SHIFT);
+		if (pos % CrInt_SHIFT + bits > CrInt_SHIFT && pos / CrInt_SHIFT + 1 < n)
+			d |= (crtwodigits)digits[pos / CrInt_SHIFT + 1] << (CrInt_SHIFT - pos % CrInt_SHIFT);
+		*--p = "0123456789abcdef"[d & (base - 1)];
+	}
+	while (p < end - 1 && *p == '0')
+		p++;
+	if (p == end)
+		*--p = '0';
+	if (sign < 0)
+		*--p = '-';
+	return CrStringObject_FromStringAndSize(p, end - p);
+}
+
+int CrInt_ClearFreeList()
+{
+	int freed = numfree;
+	while (free_list != NULL)
+	{
+		CrIntObject* obj = free_list;
+		free_list = (CrIntObject*)Cr_TYPE(obj);
+		CrIntType.tp_free(obj);
+	}
+	numfree = 0;
+	return freed;
+}
+
+void CrInt_SetFreeListLimit(int limit)
+{
+	maxfree = limit < 0 ? 0 : limit;
+	while (numfree > maxfree)
+	{
+		CrIntObject* obj = free_list;
+		free_list = (CrIntObject*)Cr_TYPE(obj);
+		CrIntType.tp_free(obj);
+		numfree--;
+	}
 }
 
 CrStatus CrInt_InitTypes()
@@ -40,5 +1484,8 @@ CrStatus CrInt_InitTypes()
 	if (CrType_Ready(&CrIntType) < 0)
 		return CrStatus_Error("can't init int type");
 
+	if (!small_ints_ready)
+		init_small_ints();
+
 	return CrStatus_Ok();
 }
@@ -4,19 +4,107 @@
 
 #include <core/status.h>
 
+/* Ints in the range [-CR_NSMALLNEGINTS, CR_NSMALLPOSINTS) are preallocated
+   once and shared, so creating them never allocates. */
+#ifndef CR_NSMALLPOSINTS
+#define CR_NSMALLPOSINTS		1025
+#endif
+#ifndef CR_NSMALLNEGINTS
+#define CR_NSMALLNEGINTS		5
+#endif
+
+/*
+ * Ints have two representations. Any value that fits in 64 bits is stored
+ * inline in ob_ival with ob_size set to 0, so ordinary arithmetic never
+ * touches the limb code. Larger values are stored as an array of 32-bit
+ * limbs, least significant first, in ob_digit; abs(ob_size) is the number
+ * of limbs and the sign of ob_size is the sign of the value. The two forms
+ * never overlap: a value that fits in 64 bits is always stored inline.
+ */
+
+typedef Cr_uint32_t crdigit;
+typedef Cr_uint64_t crtwodigits;
+
+#define CrInt_SHIFT		32
+#define CrInt_BASE		((crtwodigits)1 << CrInt_SHIFT)
+#define CrInt_MASK		((crdigit)(CrInt_BASE - 1))
+
 typedef struct _intobject
 {
 	CrObject_VAR_HEAD;
-	Cr_int32_t ob_ival;
+	Cr_int64_t ob_ival;			// Value if ob_size == 0
+	crdigit ob_digit[1];		// Limbs if ob_size != 0
 } CrIntObject;
 
 /* Type object */
 extern CrTypeObject CrIntType;
 
+/* Type check macros */
+#define CrInt_Check(self) CrType_FastSubClass(Cr_TYPE(self), TPFLAGS_LONG_SUBCLASS)
+#define CrInt_CheckExact(self) Cr_IS_TYPE(self, &CrIntType)
 
-/* Convert a C++ int to a CrIntObject */
+/* True if the int is stored inline (or tagged) rather than as limbs */
+static inline int CrInt_IS_SMALL(CrObject* op)
+{
+#ifdef Cr_TAGGED_INTS
+	if (CrObject_IS_TAGGED(op))
+		return 1;
+#endif
+	return Cr_SIZE(op) == 0;
+}
+
+/* Value of a small int, which may be a tagged int (see objects/object.h) */
+static inline Cr_int64_t CrInt_VALUE(CrObject* op)
+{
+#ifdef Cr_TAGGED_INTS
+	if (CrObject_IS_TAGGED(op))
+		return (Cr_int64_t)CrTaggedInt_VALUE(op);
+#endif
+	return ((CrIntObject*)op)->ob_ival;
+}
+
+/* Convert a C++ value to a CrIntObject */
 CrObject* CrIntObject_FromInt(Cr_int32_t ival);
+CrObject* CrIntObject_FromLongLong(Cr_int64_t ival);
+CrObject* CrIntObject_FromDouble(double dval);
+
+/* Parse an int literal in the given base (2 to 36), or with base 0 take
+   the base from a 0x/0o/0b prefix. Underscores between digits are allowed.
+   Sets ValueError and returns NULL on a malformed literal. */
 CrObject* CrIntObject_FromString(const char* str, int base);
 
+/* API Functions */
+
+/* Return the value as a C++ integer. If it does not fit, *overflow is set
+   to the sign of the value and -1 is returned. */
+Cr_int64_t CrInt_AsLongLong(CrObject* op, int* overflow);
+double CrInt_AsDouble(CrObject* op);
+
+CrObject* CrInt_Add(CrObject* a, CrObject* b);
+CrObject* CrInt_Subtract(CrObject* a, CrObject* b);
+CrObject* CrInt_Multiply(CrObject* a, CrObject* b);
+CrObject* CrInt_Negate(CrObject* op);
+
+/* Division rounds towards minus infinity and the remainder has the sign of
+   the divisor. Both raise ZeroDivisionError for a zero divisor. */
+CrObject* CrInt_FloorDivide(CrObject* a, CrObject* b);
+CrObject* CrInt_Remainder(CrObject* a, CrObject* b);
+
+/* a / b as a correctly rounded float */
+CrObject* CrInt_TrueDivide(CrObject* a, CrObject* b);
+
+/* Returns -1, 0 or 1 */
+int CrInt_Compare(CrObject* a, CrObject* b);
+
+/* Exact comparison of an int against a double, without rounding the int */
+int CrInt_EqualsDouble(CrObject* op, double dval);
+
+/* Format the int in base 2, 8, 10 or 16, without a prefix */
+CrObject* CrInt_Format(CrObject* op, int base);
+
+/* Free list management, returns the number of objects released */
+int CrInt_ClearFreeList();
+void CrInt_SetFreeListLimit(int limit);
+
 /* Runtime lifecycle */
 CrStatus CrInt_InitTypes();
\ No newline at end of file
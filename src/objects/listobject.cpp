@@ -1,7 +1,38 @@
 #include "listobject.h"
 
+#include <objects/abstract.h>
 #include <objects/baseobject.h>
+#include <objects/boolobject.h>
 #include <core/error.h>
+#include <core/gc.h>
+
+/*
+* 
+*		Free list
+* 
+*/
+
+/* Dead list objects are chained through ob_type. A list keeps its item
+   buffer while it sits on the free list as long as the buffer holds at
+   most LIST_FREELIST_MAXALLOC items, so short temporary lists are reused
+   together with their storage. */
+
+#ifndef CrList_MAXFREELIST
+#define CrList_MAXFREELIST 80
+#endif
+
+#define LIST_FREELIST_MAXALLOC 16
+
+static CrListObject* free_list = NULL;
+static int numfree = 0;
+static int maxfree = CrList_MAXFREELIST;
+
+static void list_free_object(CrListObject* obj)
+{
+	if (obj->ob_items != NULL)
+		Mem_Free(obj->ob_items);
+	CrListType.tp_free(obj);
+}
 
 /*
 * 
@@ -16,7 +47,8 @@ static int list_resize(CrListObject* self, Cr_size_t new_size)
 	size_t new_allocated, num_allocated_bytes;
 	Cr_size_t allocated = self->allocated;
 
-	if (allocated >= new_size && new_size >= (allocated >> 1))
+	/* Small buffers are never shrunk, they are kept for reuse */
+	if (allocated >= new_size && (new_size >= (allocated >> 1) || allocated <= LIST_FREELIST_MAXALLOC))
 	{
 		assert(self->ob_items != NULL || new_size != 0);
 		VAROBJECT_SET_SIZE(self, new_size);
@@ -82,22 +114,126 @@ static inline int valid_index(Cr_size_t i, Cr_size_t limit)
 static void list_dealloc(CrListObject* self)
 {
 	Cr_size_t i;
-	// Untrack list for GC
-	// begin trashcan
+	CrObject_GC_UnTrack(self);
 	if (self->ob_items != NULL)
 	{
 		i = Cr_SIZE(self);
 		while (--i >= 0)
 		{
-			CrObject_DECREF(self->ob_items[i]);
+			CrObject_XDECREF(self->ob_items[i]);
 		}
-		Mem_Free(self->ob_items);
 	}
+	if (CrList_CheckExact(self) && numfree < maxfree)
+	{
+		if (self->allocated > LIST_FREELIST_MAXALLOC)
+		{
+			Mem_Free(self->ob_items);
+			self->ob_items = NULL;
+			self->allocated = 0;
+		}
+		VAROBJECT_SET_SIZE(self, 0);
+		CrObject_SET_TYPE(self, (CrTypeObject*)free_list);
+		free_list = self;
+		numfree++;
+		return;
+	}
+	if (self->ob_items != NULL)
+		Mem_Free(self->ob_items);
 	Cr_TYPE(self)->tp_free((CrObject*)self);
+}
 
-	// end trashcan
+static int list_traverse(CrListObject* self, visitproc visit, void* arg)
+{
+	for (Cr_size_t i = Cr_SIZE(self); --i >= 0; )
+		Cr_VISIT(self->ob_items[i]);
+	return 0;
 }
 
+static CrObject* list_add(CrObject* a, CrObject* b)
+{
+	if (!CrList_Check(a) || !CrList_Check(b))
+		Cr_RETURN_NOTIMPLEMENTED;
+
+	Cr_size_t na = Cr_SIZE(a), nb = Cr_SIZE(b);
+	CrListObject* result = (CrListObject*)CrListObject_New(na + nb);
+	if (result == NULL)
+		return NULL;
+
+	CrObject** src = ((CrListObject*)a)->ob_items;
+	CrObject** dest = result->ob_items;
+	for (Cr_size_t i = 0; i < na; i++)
+		dest[i] = CrObject_NEWREF(src[i]);
+	src = ((CrListObject*)b)->ob_items;
+	dest = result->ob_items + na;
+	for (Cr_size_t i = 0; i < nb; i++)
+		dest[i] = CrObject_NEWREF(src[i]);
+	return (CrObject*)result;
+}
+
+static int list_bool(CrObject* self)
+{
+	return Cr_SIZE(self) != 0;
+}
+
+/* Lexicographic, the first pair of items that differ decides */
+static CrObject* list_richcompare(CrObject* v, CrObject* w, int op)
+{
+	if (!CrList_Check(v) || !CrList_Check(w))
+		Cr_RETURN_NOTIMPLEMENTED;
+
+	CrListObject* vl = (CrListObject*)v;
+	CrListObject* wl = (CrListObject*)w;
+	if (Cr_SIZE(vl) != Cr_SIZE(wl) && (op == Cr_EQ || op == Cr_NE))
+		Cr_RETURN_RICHCOMPARE(0, 1, op);
+
+	/* The sizes are checked on every step, comparing items can run code
+	   that changes either list */
+	Cr_size_t i;
+	for (i = 0; i < Cr_SIZE(vl) && i < Cr_SIZE(wl); i++)
+	{
+		CrObject* vitem = vl->ob_items[i];
+		CrObject* witem = wl->ob_items[i];
+		if (vitem == witem)
+			continue;
+
+		CrObject_INCREF(vitem);
+		CrObject_INCREF(witem);
+		int k = CrObject_RichCompareBool(vitem, witem, Cr_EQ);
+		CrObject_DECREF(vitem);
+		CrObject_DECREF(witem);
+		if (k < 0)
+			return NULL;
+		if (!k)
+			break;
+	}
+
+	if (i >= Cr_SIZE(vl) || i >= Cr_SIZE(wl))
+		Cr_RETURN_RICHCOMPARE(Cr_SIZE(vl), Cr_SIZE(wl), op);
+
+	if (op == Cr_EQ)
+		Cr_RETURN_FALSE;
+	if (op == Cr_NE)
+		Cr_RETURN_TRUE;
+	return CrObject_RichCompare(vl->ob_items[i], wl->ob_items[i], op);
+}
+
+static CrObject* list_iter(CrObject* self);
+
+static CrNumberMethods list_as_number = {
+	list_add,								// nb_add
+	0,										// nb_subtract
+	0,										// nb_multiply
+	0,										// nb_remainder
+	0,										// nb_floor_divide
+	0,										// nb_true_divide
+	0,										// nb_negative
+	0,										// nb_positive
+	0,										// nb_absolute
+	list_bool,								// nb_bool
+	0,										// nb_int
+	0										// nb_float
+};
+
 CrTypeObject CrListType = {
 	VAROBJECT_HEAD_INIT(&CrListType, 0)		// base
 	"list",									// tp_name
@@ -105,32 +241,152 @@ CrTypeObject CrListType = {
 	sizeof(CrListObject),					// tp_size
 	0,										// tp_itemsize
 	TPFLAGS_DEFAULT | TPFLAGS_BASETYPE |	// tp_flags
-		TPFLAGS_LIST_SUBCLASS,
+		TPFLAGS_HAVE_GC | TPFLAGS_LIST_SUBCLASS,
 	(destructor)list_dealloc,				// tp_dealloc
+	0,										// tp_hash
+	&list_as_number,						// tp_as_number
+	list_richcompare,						// tp_richcompare
+	list_iter,								// tp_iter
+	0,										// tp_iternext
+	0,										// tp_getattro
+	0,										// tp_call
+	(traverseproc)list_traverse,			// tp_traverse
+	CrList_Clear,							// tp_clear
 	&CrBaseObjectType,						// tp_base
-	Mem_Free								// tp_free
+	0,										// tp_depth
+	0,										// tp_display
+	CrObject_GC_Del							// tp_free
+};
+
+/*
+*
+*		Iterator
+*
+*/
+
+typedef struct
+{
+	CrObject_HEAD
+	Cr_size_t it_index;
+	CrListObject* it_seq;			// Set to NULL when the iterator is exhausted
+} listiterobject;
+
+static void listiter_dealloc(listiterobject* it)
+{
+	CrObject_GC_UnTrack(it);
+	CrObject_XDECREF(it->it_seq);
+	Cr_TYPE(it)->tp_free((CrObject*)it);
+}
+
+static int listiter_traverse(listiterobject* it, visitproc visit, void* arg)
+{
+	Cr_VISIT(it->it_seq);
+	return 0;
+}
+
+/* The list may grow or shrink while it is iterated, the index is checked
+   against its current size on every step */
+static CrObject* listiter_next(listiterobject* it)
+{
+	CrListObject* seq = it->it_seq;
+	if (seq == NULL)
+		return NULL;
+
+	if (it->it_index < Cr_SIZE(seq))
+		return CrObject_NEWREF(seq->ob_items[it->it_index++]);
+
+	it->it_seq = NULL;
+	CrObject_DECREF(seq);
+	return NULL;
+}
+
+CrTypeObject CrListIterType = {
+	VAROBJECT_HEAD_INIT(&CrBaseType, 0)		// base
+	"list_iterator",						// tp_name
+	0,										// tp_doc
+	sizeof(listiterobject),					// tp_size
+	0,										// tp_itemsize
+	TPFLAGS_DEFAULT | TPFLAGS_HAVE_GC,		// tp_flags
+	(destructor)listiter_dealloc,			// tp_dealloc
+	0,										// tp_hash
+	0,										// tp_as_number
+	0,										// tp_richcompare
+	CrObject_SelfIter,						// tp_iter
+	(iternextfunc)listiter_next,			// tp_iternext
+	0,										// tp_getattro
+	0,										// tp_call
+	(traverseproc)listiter_traverse,		// tp_traverse
+	0,										// tp_clear
+	0,										// tp_base
+	0,										// tp_depth
+	0,										// tp_display
+	CrObject_GC_Del							// tp_free
 };
 
+static CrObject* list_iter(CrObject* self)
+{
+	listiterobject* it = CrObject_GC_NEW(listiterobject, &CrListIterType);
+	if (it == NULL)
+		return NULL;
+	it->it_index = 0;
+	it->it_seq = (CrListObject*)CrObject_NEWREF(self);
+	CrObject_GC_Track(it);
+	return (CrObject*)it;
+}
+
 CrObject* CrListObject_New(Cr_size_t size)
 {
 	CrListObject* obj;
-	size_t alloc;
 
-	obj = CrObject_NEW(CrListObject, &CrListType);
-	if (obj == NULL)
+	if (size < 0)
+	{
+		CrError_BadInternalCall();
 		return NULL;
+	}
+
+	obj = free_list;
+	if (obj != NULL)
+	{
+		free_list = (CrListObject*)Cr_TYPE(obj);
+		numfree--;
+		ObjectInit((CrObject*)obj, &CrListType);
+		if (size <= obj->allocated)
+		{
+			/* Reuse the buffer the list kept on the free list */
+			if (size > 0)
+				memset(obj->ob_items, 0, size * sizeof(CrObject*));
+			VAROBJECT_SET_SIZE(obj, size);
+			CrObject_GC_Track(obj);
+			return (CrObject*)obj;
+		}
+		Mem_Free(obj->ob_items);
+	}
+	else
+	{
+		obj = CrObject_GC_NEW(CrListObject, &CrListType);
+		if (obj == NULL)
+			return NULL;
+	}
+
 	if (size == 0)
 	{
 		obj->ob_items = NULL;
-		alloc = 0;
 	}
 	else
 	{
-		alloc = size * sizeof(CrObject*);
-		obj->ob_items = (CrObject**)Mem_Alloc(alloc);
+		obj->ob_items = (CrObject**)Mem_Calloc(size, sizeof(CrObject*));
+		if (obj->ob_items == NULL)
+		{
+			obj->allocated = 0;
+			VAROBJECT_SET_SIZE(obj, 0);
+			CrObject_DECREF(obj);
+			CrError_NoMemory();
+			return NULL;
+		}
 	}
 	VAROBJECT_SET_SIZE(obj, size);
 	obj->allocated = size;
+	CrObject_GC_Track(obj);
 	return (CrObject*)obj;
 }
 
@@ -145,7 +401,7 @@ int CrList_Append(CrObject* list, CrObject* new_item)
 int CrList_SetItem(CrObject* list, Cr_size_t i, CrObject* newitem)
 {
 	CrObject** p;
-	if (CrList_Check(list))
+	if (!CrList_Check(list))
 	{
 		CrObject_XDECREF(newitem);
 		CrError_BadInternalCall();
@@ -162,10 +418,60 @@ int CrList_SetItem(CrObject* list, Cr_size_t i, CrObject* newitem)
 	return 0;
 }
 
+int CrList_Clear(CrObject* list)
+{
+	if (!CrList_Check(list))
+	{
+		CrError_BadInternalCall();
+		return -1;
+	}
+
+	/* Pop the items one by one so a destructor that touches the list
+	   never sees a released item. The buffer is kept for reuse. */
+	CrListObject* self = (CrListObject*)list;
+	while (Cr_SIZE(self) > 0)
+	{
+		Cr_size_t i = Cr_SIZE(self) - 1;
+		CrObject* item = self->ob_items[i];
+		self->ob_items[i] = NULL;
+		VAROBJECT_SET_SIZE(self, i);
+		CrObject_XDECREF(item);
+	}
+	return 0;
+}
+
+int CrList_ClearFreeList()
+{
+	int freed = numfree;
+	while (free_list != NULL)
+	{
+		CrListObject* obj = free_list;
+		free_list = (CrListObject*)Cr_TYPE(obj);
+		list_free_object(obj);
+	}
+	numfree = 0;
+	return freed;
+}
+
+void CrList_SetFreeListLimit(int limit)
+{
+	maxfree = limit < 0 ? 0 : limit;
+	while (numfree > maxfree)
+	{
+		CrListObject* obj = free_list;
+		free_list = (CrListObject*)Cr_TYPE(obj);
+		list_free_object(obj);
+		numfree--;
+	}
+}
+
 CrStatus CrList_InitTypes()
 {
 	if (CrType_Ready(&CrListType) < 0)
 		return CrStatus_Error("can't init list type");
 
+	if (CrType_Ready(&CrListIterType) < 0)
+		return CrStatus_Error("can't init list iterator type");
+
 	return CrStatus_Ok();
 }
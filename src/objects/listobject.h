@@ -11,11 +11,12 @@ typedef struct _listobject
 	Cr_size_t allocated;
 } CrListObject;
 
-/* Type object */
+/* Type objects */
 extern CrTypeObject CrListType;
+extern CrTypeObject CrListIterType;
 
 /* Type check macros */
-#define CrList_Check(self) CrObject_TypeCheck(self, &CrListType)
+#define CrList_Check(self) CrType_FastSubClass(Cr_TYPE(self), TPFLAGS_LIST_SUBCLASS)
 #define CrList_CheckExact(self) Cr_IS_TYPE(self, &CrListType)
 
 CrObject* CrListObject_New(Cr_size_t size);
@@ -23,6 +24,7 @@ CrObject* CrListObject_New(Cr_size_t size);
 /* API Functions */
 int CrList_Append(CrObject* list, CrObject* new_item);
 int CrList_SetItem(CrObject* list, Cr_size_t i, CrObject* newitem);
+int CrList_Clear(CrObject* list);
 
 #define CrList_CAST(obj) (assert(CrList_Check(obj)), ((CrListObject*)obj))
 
@@ -30,5 +32,9 @@ int CrList_SetItem(CrObject* list, Cr_size_t i, CrObject* newitem);
 #define CrList_SET_ITEM(obj, i, v)  ((void)(CrList_CAST(obj)->ob_items[i] = (v)))
 #define CrList_GET_SIZE(obj)        Cr_SIZE(CrList_CAST(obj))
 
+/* Free list management, returns the number of objects released */
+int CrList_ClearFreeList();
+void CrList_SetFreeListLimit(int limit);
+
 /* Runtime lifecycle */
 CrStatus CrList_InitTypes();
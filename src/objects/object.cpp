@@ -1,6 +1,7 @@
 #include "object.h"
 
 #include <core/error.h>
+#include <core/hash.h>
 
 #include <objects/baseobject.h>
 
@@ -12,15 +13,53 @@ CrTypeObject CrNullType = {
 	0,										// tp_itemsize
 	TPFLAGS_DEFAULT,						// tp_flags
 	0,										// tp_dealloc
+	CrObject_GenericHash,					// tp_hash
+	0,										// tp_as_number
+	0,										// tp_richcompare
+	0,										// tp_iter
+	0,										// tp_iternext
+	0,										// tp_getattro
+	0,										// tp_call
+	0,										// tp_traverse
+	0,										// tp_clear
 	0,										// tp_base
-	Mem_Free								// tp_free
+	0,										// tp_depth
+	0,										// tp_display
+	Mem_ObjectFree							// tp_free
 };
 
 CrObject CrNullStruct = {
-	1, &CrNullType
+	CR_IMMORTAL_REFCNT, &CrNullType
 };
 
-static int type_is_subtype_chain(CrTypeObject* a, CrTypeObject* b)
+CrTypeObject CrNotImplementedType = {
+	VAROBJECT_HEAD_INIT(&CrBaseType, 0)		// base
+	"NotImplementedType",					// tp_name
+	0,										// tp_doc
+	0,										// tp_size
+	0,										// tp_itemsize
+	TPFLAGS_DEFAULT,						// tp_flags
+	0,										// tp_dealloc
+	CrObject_GenericHash,					// tp_hash
+	0,										// tp_as_number
+	0,										// tp_richcompare
+	0,										// tp_iter
+	0,										// tp_iternext
+	0,										// tp_getattro
+	0,										// tp_call
+	0,										// tp_traverse
+	0,										// tp_clear
+	0,										// tp_base
+	0,										// tp_depth
+	0,										// tp_display
+	Mem_ObjectFree							// tp_free
+};
+
+CrObject CrNotImplementedStruct = {
+	CR_IMMORTAL_REFCNT, &CrNotImplementedType
+};
+
+int _CrType_IsSubtypeChain(CrTypeObject* a, CrTypeObject* b)
 {
 	do {
 		if (a == b)
@@ -30,33 +69,86 @@ static int type_is_subtype_chain(CrTypeObject* a, CrTypeObject* b)
 	return (b == &CrBaseObjectType);
 }
 
-int CrType_IsSubtype(CrTypeObject* a, CrTypeObject* b)
+Cr_hash_t CrObject_Hash(CrObject* obj)
 {
-	return type_is_subtype_chain(a, b);
+	CrTypeObject* type = Cr_TYPE(obj);
+	if (type->tp_hash != NULL)
+		return type->tp_hash(obj);
+
+	CrError_SetString(CrExc_TypeError, "unhashable type");
+	return -1;
+}
+
+/* Hash by identity */
+Cr_hash_t CrObject_GenericHash(CrObject* obj)
+{
+	return CrHash_Pointer(obj);
+}
+
+CrObject* CrObject_SelfIter(CrObject* obj)
+{
+	return CrObject_NEWREF(obj);
 }
 
 CrObject* Object_New(CrTypeObject* type)
 {
-	CrObject* obj = (CrObject*)Mem_Alloc(type->tp_size);
+	CrObject* obj = (CrObject*)Mem_ObjectAlloc(type->tp_size);
+	if (obj == NULL)
+		return NULL;
 	ObjectInit(obj, type);
 	return obj;
 }
 
+CrVarObject* Object_NewVar(CrTypeObject* type, Cr_size_t nitems)
+{
+	CrVarObject* obj = (CrVarObject*)Mem_ObjectAlloc(CrObject_VAR_SIZE(type, nitems));
+	if (obj == NULL)
+		return NULL;
+	ObjectInitVar(obj, type, nitems);
+	return obj;
+}
+
 void ObjectNewRef(CrObject* obj)
 {
 	obj->ob_refcount = 1;
 }
 
-CrObject* Object_NewRef(CrObject* obj)
+/* Copy the slots a type leaves NULL from its base. tp_hash is not
+   inherited, a NULL tp_hash is how a type says it is unhashable. */
+static void inherit_slots(CrTypeObject* type, CrTypeObject* base)
 {
-	CrObject_INCREF(obj);
-	return obj;
+#define COPYSLOT(slot) \
+	if (type->slot == NULL) type->slot = base->slot
+
+	COPYSLOT(tp_as_number);
+	COPYSLOT(tp_richcompare);
+	COPYSLOT(tp_iter);
+	COPYSLOT(tp_iternext);
+	COPYSLOT(tp_getattro);
+	COPYSLOT(tp_call);
+
+#undef COPYSLOT
 }
 
-CrObject* Object_XNewRef(CrObject* obj)
+/* Build the type's display from its base's, which must be ready already */
+static int type_ready_display(CrTypeObject* type, CrTypeObject* base)
 {
-	CrObject_XINCREF(obj);
-	return obj;
+	Cr_size_t depth = (base != NULL) ? base->tp_depth + 1 : 0;
+
+	CrTypeObject** display = (CrTypeObject**)Mem_RawAlloc((depth + 1) * sizeof(CrTypeObject*));
+	if (display == NULL)
+	{
+		CrError_NoMemory();
+		return -1;
+	}
+
+	if (base != NULL)
+		memcpy(display, base->tp_display, depth * sizeof(CrTypeObject*));
+	display[depth] = type;
+
+	type->tp_depth = depth;
+	type->tp_display = display;
+	return 0;
 }
 
 int CrType_Ready(CrTypeObject* type)
@@ -101,7 +193,21 @@ int CrType_Ready(CrTypeObject* type)
 	// Initialize ob_type if NULL
 	if (Cr_IS_TYPE(type, NULL) && base != NULL)
 		CrObject_SET_TYPE(type, Cr_TYPE(base));
-error:
+
+	if (base != NULL)
+	{
+		inherit_slots(type, base);
+		type->tp_flags |= (base->tp_flags & TPFLAGS_FAST_SUBCLASS_MASK);
+	}
+
+	if (type_ready_display(type, base) < 0)
+		goto error;
+
+	type->tp_flags |= TPFLAGS_READY;
 	type->tp_flags &= ~TPFLAGS_READYING;
 	return 0;
+
+error:
+	type->tp_flags &= ~TPFLAGS_READYING;
+	return -1;
 }
@@ -9,7 +9,7 @@ struct _typeobject;
 #define CrObject_HEAD CrObject ob_base;
 
 #define CrObject_HEAD_INIT(type) \
-	{1, type},
+	{CR_IMMORTAL_REFCNT, type},
 
 #define VAROBJECT_HEAD_INIT(type, size) \
 	{CrObject_HEAD_INIT(type) size},
@@ -32,6 +32,20 @@ typedef struct _object
 #define CrObject_CAST(op) ((CrObject*)(op))
 #define CrObject_CAST_CONST(op) ((const CrObject*)(op))
 
+/*
+ * Immortal objects
+ *
+ * An object whose reference count is at least CR_IMMORTAL_REFCNT is never
+ * deallocated, and the reference count functions don't write to it, so
+ * singletons shared by all code don't bounce their cache line around on
+ * every INCREF/DECREF. Statically allocated objects are immortal from the
+ * start through CrObject_HEAD_INIT. The test is a range rather than an
+ * exact value so that stray increments can't make an object mortal.
+ */
+#define CR_IMMORTAL_REFCNT			((intptr_t)(INTPTR_MAX >> 2))
+#define CrObject_IS_IMMORTAL(ob)	(CrObject_CAST(ob)->ob_refcount >= CR_IMMORTAL_REFCNT)
+#define CrObject_SET_IMMORTAL(ob)	(CrObject_CAST(ob)->ob_refcount = CR_IMMORTAL_REFCNT)
+
 typedef struct _varobject
 {
 	CrObject ob_base;
@@ -58,6 +72,36 @@ method blocks.
 
 typedef void (*freefunc)(void*);
 typedef void (*destructor)(CrObject*);
+typedef Cr_hash_t (*hashfunc)(CrObject*);
+typedef int (*visitproc)(CrObject*, void*);
+typedef int (*traverseproc)(CrObject*, visitproc, void*);
+typedef int (*inquiry)(CrObject*);
+typedef CrObject* (*unaryfunc)(CrObject*);
+typedef CrObject* (*binaryfunc)(CrObject*, CrObject*);
+typedef CrObject* (*ternaryfunc)(CrObject*, CrObject*, CrObject*);
+typedef CrObject* (*richcmpfunc)(CrObject*, CrObject*, int);
+typedef CrObject* (*getiterfunc)(CrObject*);
+typedef CrObject* (*iternextfunc)(CrObject*);
+typedef CrObject* (*getattrofunc)(CrObject*, CrObject*);
+
+/* Numeric operations. A binary slot is looked up on both operands, so it
+   must check the type of each argument and return Cr_NotImplemented for
+   combinations it doesn't handle. See objects/abstract.h. */
+typedef struct
+{
+	binaryfunc nb_add;
+	binaryfunc nb_subtract;
+	binaryfunc nb_multiply;
+	binaryfunc nb_remainder;
+	binaryfunc nb_floor_divide;
+	binaryfunc nb_true_divide;
+	unaryfunc nb_negative;
+	unaryfunc nb_positive;
+	unaryfunc nb_absolute;
+	inquiry nb_bool;
+	unaryfunc nb_int;
+	unaryfunc nb_float;
+} CrNumberMethods;
 
 typedef struct _typeobject
 {
@@ -71,22 +115,79 @@ typedef struct _typeobject
 	/* Methods to implement standard operations */
 
 	destructor tp_dealloc;
+	hashfunc tp_hash;				// NULL for unhashable types
+
+	CrNumberMethods* tp_as_number;
+	richcmpfunc tp_richcompare;		// Takes one of the Cr_LT .. Cr_GE operators
+	getiterfunc tp_iter;
+	iternextfunc tp_iternext;		// NULL without an error set when exhausted
+	getattrofunc tp_getattro;
+	ternaryfunc tp_call;			// Positional arguments and keywords, keywords may be NULL
+
+	/* Garbage collector support, for types with TPFLAGS_HAVE_GC (see core/gc.h) */
+
+	traverseproc tp_traverse;		// Call visit on every object this one references
+	inquiry tp_clear;				// Drop the references that could form cycles
 
-	
 	struct _typeobject* tp_base;	// Strong reference on a heap type, borrowed reference on a static type
+
+	/* Filled in by CrType_Ready(): tp_display[i] is the ancestor at depth i,
+	   from CrBaseObjectType at 0 down to the type itself at tp_depth */
+	Cr_size_t tp_depth;
+	struct _typeobject** tp_display;
+
 	freefunc tp_free;				// Low-level free memory routine
 } CrTypeObject;
 
-#define Cr_TYPE(ob)             (CrObject_CAST(ob)->ob_type)
+/*
+ * Tagged ints
+ *
+ * With Cr_TAGGED_INTS defined an int is not allocated at all; its value is
+ * stored in the object pointer itself, shifted left by one with the low
+ * bit set. Real objects are always aligned, so their low bit is never set.
+ * Tagged ints have no reference count and are never deallocated, and
+ * their type is always CrIntType. Only Cr_TYPE() and the reference count
+ * functions may be applied to a pointer that could be tagged; everything
+ * else has to go through the CrInt_* accessors.
+ */
+#ifdef Cr_TAGGED_INTS
+#	define CrObject_IS_TAGGED(ob)		(((uintptr_t)(ob)) & 1)
+#	define CrTaggedInt_FromValue(v)	((CrObject*)((((uintptr_t)(intptr_t)(v)) << 1) | 1))
+#	define CrTaggedInt_VALUE(ob)		(((intptr_t)(ob)) >> 1)
+#	define CrTaggedInt_MIN				(INTPTR_MIN >> 1)
+#	define CrTaggedInt_MAX				(INTPTR_MAX >> 1)
+
+extern CrTypeObject CrIntType;
+#else
+#	define CrObject_IS_TAGGED(ob)		0
+#endif
+
+#define Cr_REFCNT(ob)           (CrObject_CAST(ob)->ob_refcount)
 #define Cr_SIZE(ob)             (CrVarObject_CAST(ob)->ob_size)
 
+static inline CrTypeObject* _Cr_TYPE(const CrObject* ob) {
+#ifdef Cr_TAGGED_INTS
+	if (CrObject_IS_TAGGED(ob))
+		return &CrIntType;
+#endif
+	return ob->ob_type;
+}
+#define Cr_TYPE(ob)             _Cr_TYPE(CrObject_CAST_CONST(ob))
+
 static inline int _Cr_IS_TYPE(const CrObject* ob, const CrTypeObject* type) {
 	return Cr_TYPE(ob) == type;
 }
 #define Cr_IS_TYPE(ob, type) _Cr_IS_TYPE(CrObject_CAST_CONST(ob), type)
 
-/* Generic type check */
-int CrType_IsSubtype(CrTypeObject* a, CrTypeObject* b);
+/* Generic type check. Once both types are ready this is a single load and
+   compare against a's display; otherwise the tp_base chain is walked. */
+int _CrType_IsSubtypeChain(CrTypeObject* a, CrTypeObject* b);
+
+static inline int CrType_IsSubtype(CrTypeObject* a, CrTypeObject* b) {
+	if (a->tp_display != NULL && b->tp_display != NULL)
+		return b->tp_depth <= a->tp_depth && a->tp_display[b->tp_depth] == b;
+	return _CrType_IsSubtypeChain(a, b);
+}
 #define CrObject_TypeCheck(ob, tp) (Cr_IS_TYPE(ob, tp) || CrType_IsSubtype(Cr_TYPE(ob), (tp)))
 
 /*
@@ -97,6 +198,22 @@ int CrType_IsSubtype(CrTypeObject* a, CrTypeObject* b);
 CrObject* Object_New(CrTypeObject* type);
 #define CrObject_NEW(type, typedef) (type *)Object_New(typedef)
 
+/* Bytes needed by a variable-size object of 'nitems' items, the header plus
+   the inline items, rounded up to the allocator alignment */
+#define CrObject_VAR_SIZE(typeobj, nitems) \
+	Cr_SIZE_ROUND_UP((typeobj)->tp_size + (size_t)(nitems) * (typeobj)->tp_itemsize, MEM_ALIGNMENT)
+
+/* Create a new variable-size object with room for 'nitems' inline items */
+CrVarObject* Object_NewVar(CrTypeObject* type, Cr_size_t nitems);
+#define CrObject_NEWVAR(type, typedef, nitems) (type *)Object_NewVar(typedef, nitems)
+
+/* Hash an object, returns -1 with an error set if it is unhashable */
+Cr_hash_t CrObject_Hash(CrObject* obj);
+Cr_hash_t CrObject_GenericHash(CrObject* obj);
+
+/* tp_iter of iterator types, returns a new reference to the object */
+CrObject* CrObject_SelfIter(CrObject* obj);
+
 /* Create a new reference to an object */
 void ObjectNewRef(CrObject* obj);
 
@@ -110,6 +227,8 @@ void ObjectNewRef(CrObject* obj);
 /* Increase object reference count */
 static inline void ObjectIncRef(CrObject* obj)
 {
+	if (CrObject_IS_TAGGED(obj) || CrObject_IS_IMMORTAL(obj))
+		return;
 	obj->ob_refcount++;
 }
 #define CrObject_INCREF(obj) ObjectIncRef(CrObject_CAST(obj))
@@ -117,6 +236,8 @@ static inline void ObjectIncRef(CrObject* obj)
 /* Decrease object reference count */
 static inline void ObjectDecRef(CrObject* obj)
 {
+	if (CrObject_IS_TAGGED(obj) || CrObject_IS_IMMORTAL(obj))
+		return;
 	obj->ob_refcount--;
 	if (obj->ob_refcount == 0)
 		obj->ob_type->tp_dealloc(obj);
@@ -141,12 +262,20 @@ static inline void ObjectXDecRef(CrObject* obj)
 
 // Create a new strong reference to an object:
 // increment the reference count of the object and return the object.
-static CrObject* Object_NewRef(CrObject* obj);
-#define CrObject_NEWREF(obj) Object_NewRef(CrObject_CAST(obj));
+static inline CrObject* Object_NewRef(CrObject* obj)
+{
+	ObjectIncRef(obj);
+	return obj;
+}
+#define CrObject_NEWREF(obj) Object_NewRef(CrObject_CAST(obj))
 
 // Similar to Cr_NewRef(), but the object can be NULL.
-static CrObject* Object_XNewRef(CrObject* obj);
-#define CrObject_XNEWREF(obj) Object_XNewRef(CrObject_CAST(obj));
+static inline CrObject* Object_XNewRef(CrObject* obj)
+{
+	ObjectXIncRef(obj);
+	return obj;
+}
+#define CrObject_XNEWREF(obj) Object_XNewRef(CrObject_CAST(obj))
 
 #define CrObject_SETREF(obj, obj2)              \
     do {                                        \
@@ -182,6 +311,13 @@ static inline void ObjectInit(CrObject* obj, CrTypeObject* type)
 	ObjectNewRef(obj);
 }
 
+/* Initialize a variable-size object */
+static inline void ObjectInitVar(CrVarObject* obj, CrTypeObject* type, Cr_size_t size)
+{
+	ObjectInit((CrObject*)obj, type);
+	VarObjectSetSize(obj, size);
+}
+
 int CrType_Ready(CrTypeObject* type);
 
 /*
@@ -213,6 +349,11 @@ int CrType_Ready(CrTypeObject* type);
 #define TPFLAGS_BASE_EXC_SUBCLASS    (1UL << 30)
 #define TPFLAGS_TYPE_SUBCLASS        (1UL << 31)
 
+/* The subclass flags a type passes on to its subtypes */
+#define TPFLAGS_FAST_SUBCLASS_MASK (TPFLAGS_LONG_SUBCLASS | TPFLAGS_LIST_SUBCLASS | \
+	TPFLAGS_TUPLE_SUBCLASS | TPFLAGS_BYTES_SUBCLASS | TPFLAGS_UNICODE_SUBCLASS | \
+	TPFLAGS_DICT_SUBCLASS | TPFLAGS_BASE_EXC_SUBCLASS | TPFLAGS_TYPE_SUBCLASS)
+
 #define TPFLAGS_DEFAULT 0
 
 static inline int CrType_HasFeature(CrTypeObject* type, unsigned long feature)
@@ -225,6 +366,7 @@ static inline int CrType_HasFeature(CrTypeObject* type, unsigned long feature)
 /*
  CrNullStruct is an object of undefined type which can be used in contexts
  where NULL (null) is not suitable (since NULL often means 'error').
+ It is immortal, but returning it should still go through CrObject_NEWREF().
 
  Don't forget to apply CrObject_NEWREF() when returning this value!!!
  */
@@ -233,4 +375,42 @@ extern CrObject CrNullStruct; // Do not use directly
 #define Cr_Null (&CrNullStruct)
 
 /* Macro for returning Cr_Null from a function */
-#define Cr_RETURN_NULL return CrObject_NEWREF(Cr_Null)
\ No newline at end of file
+#define Cr_RETURN_NULL return CrObject_NEWREF(Cr_Null)
+
+/*
+ Cr_NotImplemented is returned by binary and comparison slots that don't
+ support the operand types, so that the other operand gets a chance. It
+ is immortal like Cr_Null.
+ */
+
+extern CrObject CrNotImplementedStruct; // Do not use directly
+#define Cr_NotImplemented (&CrNotImplementedStruct)
+
+/* Macro for returning Cr_NotImplemented from a function */
+#define Cr_RETURN_NOTIMPLEMENTED return CrObject_NEWREF(Cr_NotImplemented)
+
+/* Rich comparison operators, the order is relied on by the reflected
+   operator table in abstract.cpp */
+#define Cr_LT 0
+#define Cr_LE 1
+#define Cr_EQ 2
+#define Cr_NE 3
+#define Cr_GT 4
+#define Cr_GE 5
+
+/* Return the bool for 'left op right' from a comparison slot, the
+   operands must be of a type that supports < and == */
+#define Cr_RETURN_RICHCOMPARE(left, right, op)								\
+	do {																	\
+		int cr_cmp;															\
+		switch (op) {														\
+		case Cr_LT: cr_cmp = (left) < (right); break;						\
+		case Cr_LE: cr_cmp = (left) <= (right); break;						\
+		case Cr_EQ: cr_cmp = (left) == (right); break;						\
+		case Cr_NE: cr_cmp = (left) != (right); break;						\
+		case Cr_GT: cr_cmp = (left) > (right); break;						\
+		case Cr_GE: cr_cmp = (left) >= (right); break;						\
+		default: assert(0); cr_cmp = 0;										\
+		}																	\
+		return CrObject_NEWREF(cr_cmp ? Cr_True : Cr_False);				\
+	} while (0)
@@ -1,6 +1,62 @@
 #include "stringobject.h"
 
 #include <core/error.h>
+#include <core/hash.h>
+#include <objects/baseobject.h>
+#include <objects/boolobject.h>
+#include <objects/dictobject.h>
+
+/*
+	Free list
+
+	Strings are recycled whole, so they are kept in one list per allocation
+	size. Only the smaller sizes, which covers almost every token, are
+	cached; the limit applies to all lists together. Dead strings are
+	chained through ob_type.
+*/
+
+#ifndef CrString_MAXFREELIST
+#define CrString_MAXFREELIST 200
+#endif
+
+#define FREELIST_BUCKETS 8
+
+static CrStringObject* free_list[FREELIST_BUCKETS];
+static int numfree = 0;
+static int maxfree = CrString_MAXFREELIST;
+
+/* Free list of a string of 'size' characters, or -1 if it is not cached */
+static inline int freelist_bucket(Cr_size_t size)
+{
+	size_t bucket = (CrObject_VAR_SIZE(&CrStringType, size) - CrObject_VAR_SIZE(&CrStringType, 0)) / MEM_ALIGNMENT;
+	return bucket < FREELIST_BUCKETS ? (int)bucket : -1;
+}
+
+static CrStringObject* freelist_pop(int bucket)
+{
+	CrStringObject* obj = free_list[bucket];
+	free_list[bucket] = (CrStringObject*)Cr_TYPE(obj);
+	numfree--;
+	return obj;
+}
+
+/* Release cached strings until at most 'limit' remain */
+static void freelist_trim(int limit)
+{
+	for (int i = FREELIST_BUCKETS - 1; i >= 0 && numfree > limit; i--)
+	{
+		while (free_list[i] != NULL && numfree > limit)
+			CrStringType.tp_free(freelist_pop(i));
+	}
+}
+
+/*
+	Intern table
+
+	A dict mapping each interned string to itself, created on first use.
+*/
+
+static CrObject* interned = NULL;
 
 /*
 	Methods
@@ -37,25 +93,165 @@ static CrObject* string_concat(CrStringObject* a, CrObject* b)
 	return (CrObject*)result;
 }
 
+static Cr_hash_t string_hash(CrStringObject* self)
+{
+	if (self->ob_shash == -1)
+		self->ob_shash = CrHash_Bytes(self->ob_svar, Cr_SIZE(self));
+	return self->ob_shash;
+}
+
 static void string_dealloc(CrStringObject* self)
 {
-	if (self->ob_svar != 0)
-		Mem_Free(self->ob_svar);
+	assert(self->ob_sstate == SSTATE_NOT_INTERNED);
+
+	int bucket = freelist_bucket(Cr_SIZE(self));
+	if (CrString_CheckExact(self) && bucket >= 0 && numfree < maxfree)
+	{
+		CrObject_SET_TYPE(self, (CrTypeObject*)free_list[bucket]);
+		free_list[bucket] = self;
+		numfree++;
+		return;
+	}
 	Cr_TYPE(self)->tp_free((CrObject*)self);
 }
 
+static CrObject* string_add(CrObject* a, CrObject* b)
+{
+	if (!CrString_CheckExact(a) || !CrString_CheckExact(b))
+		Cr_RETURN_NOTIMPLEMENTED;
+	return string_concat((CrStringObject*)a, b);
+}
+
+static int string_bool(CrObject* self)
+{
+	return Cr_SIZE(self) != 0;
+}
+
+/* Strings order bytewise, which for UTF-8 is code point order */
+CrObject* _CrString_RichCompare(CrObject* a, CrObject* b, int op)
+{
+	Cr_size_t na = Cr_SIZE(a), nb = Cr_SIZE(b);
+	if ((op == Cr_EQ || op == Cr_NE) && (na != nb || a == b))
+		return CrBool_FromLong((na == nb) == (op == Cr_EQ));
+
+	int c = memcmp(((CrStringObject*)a)->ob_svar, ((CrStringObject*)b)->ob_svar, na < nb ? na : nb);
+	if (c == 0)
+		c = na < nb ? -1 : na > nb;
+	Cr_RETURN_RICHCOMPARE(c, 0, op);
+}
+
+static CrObject* string_richcompare(CrObject* a, CrObject* b, int op)
+{
+	if (!CrString_Check(a) || !CrString_Check(b))
+		Cr_RETURN_NOTIMPLEMENTED;
+	return _CrString_RichCompare(a, b, op);
+}
+
+static CrObject* string_iter(CrObject* self);
+
+static CrNumberMethods string_as_number = {
+	string_add,								// nb_add
+	0,										// nb_subtract
+	0,										// nb_multiply
+	0,										// nb_remainder
+	0,										// nb_floor_divide
+	0,										// nb_true_divide
+	0,										// nb_negative
+	0,										// nb_positive
+	0,										// nb_absolute
+	string_bool,							// nb_bool
+	0,										// nb_int
+	0										// nb_float
+};
+
 CrTypeObject CrStringType = {
 	VAROBJECT_HEAD_INIT(&CrStringType, 0)	// base
 	"string",								// tp_name
 	"String object type",					// tp_doc
 	sizeof(CrStringObject),					// tp_size
-	0,										// tp_itemsize
-	TPFLAGS_DEFAULT | TPFLAGS_BASETYPE,		// tp_flags
+	sizeof(char),							// tp_itemsize
+	TPFLAGS_DEFAULT | TPFLAGS_BASETYPE |	// tp_flags
+		TPFLAGS_UNICODE_SUBCLASS,
 	(destructor)string_dealloc,				// tp_dealloc
+	(hashfunc)string_hash,					// tp_hash
+	&string_as_number,						// tp_as_number
+	string_richcompare,						// tp_richcompare
+	string_iter,							// tp_iter
+	0,										// tp_iternext
+	0,										// tp_getattro
+	0,										// tp_call
+	0,										// tp_traverse
+	0,										// tp_clear
 	0,										// tp_base
-	Mem_Free								// tp_free
+	0,										// tp_depth
+	0,										// tp_display
+	Mem_ObjectFree							// tp_free
 };
 
+/*
+	Iterator
+*/
+
+typedef struct
+{
+	CrObject_HEAD
+	Cr_size_t it_index;
+	CrStringObject* it_seq;			// Set to NULL when the iterator is exhausted
+} stringiterobject;
+
+static void stringiter_dealloc(stringiterobject* it)
+{
+	CrObject_XDECREF(it->it_seq);
+	Cr_TYPE(it)->tp_free((CrObject*)it);
+}
+
+static CrObject* stringiter_next(stringiterobject* it)
+{
+	CrStringObject* seq = it->it_seq;
+	if (seq == NULL)
+		return NULL;
+
+	if (it->it_index < Cr_SIZE(seq))
+		return CrStringObject_FromStringAndSize(seq->ob_svar + it->it_index++, 1);
+
+	it->it_seq = NULL;
+	CrObject_DECREF(seq);
+	return NULL;
+}
+
+CrTypeObject CrStringIterType = {
+	VAROBJECT_HEAD_INIT(&CrBaseType, 0)		// base
+	"string_iterator",						// tp_name
+	0,										// tp_doc
+	sizeof(stringiterobject),				// tp_size
+	0,										// tp_itemsize
+	TPFLAGS_DEFAULT,						// tp_flags
+	(destructor)stringiter_dealloc,			// tp_dealloc
+	0,										// tp_hash
+	0,										// tp_as_number
+	0,										// tp_richcompare
+	CrObject_SelfIter,						// tp_iter
+	(iternextfunc)stringiter_next,			// tp_iternext
+	0,										// tp_getattro
+	0,										// tp_call
+	0,										// tp_traverse
+	0,										// tp_clear
+	0,										// tp_base
+	0,										// tp_depth
+	0,										// tp_display
+	Mem_ObjectFree							// tp_free
+};
+
+static CrObject* string_iter(CrObject* self)
+{
+	stringiterobject* it = CrObject_NEW(stringiterobject, &CrStringIterType);
+	if (it == NULL)
+		return NULL;
+	it->it_index = 0;
+	it->it_seq = (CrStringObject*)CrObject_NEWREF(self);
+	return (CrObject*)it;
+}
+
 CrObject* CrStringObject_FromString(const char* bytes)
 {
 	return CrStringObject_FromStringAndSize(bytes, strlen(bytes));
@@ -64,7 +260,6 @@ CrObject* CrStringObject_FromString(const char* bytes)
 CrObject* CrStringObject_FromStringAndSize(const char* bytes, Cr_size_t size)
 {
 	CrStringObject* obj;
-	size_t alloc;
 
 	if (size < 0)
 	{
@@ -72,24 +267,23 @@ CrObject* CrStringObject_FromStringAndSize(const char* bytes, Cr_size_t size)
 		return NULL;
 	}
 
-	obj = CrObject_NEW(CrStringObject, &CrStringType);
-	if (obj == NULL)
-		return NULL;
-	if (size == 0)
+	int bucket = freelist_bucket(size);
+	if (bucket >= 0 && free_list[bucket] != NULL)
 	{
-		obj->ob_svar = NULL;
-		alloc = 0;
+		obj = freelist_pop(bucket);
+		ObjectInitVar((CrVarObject*)obj, &CrStringType, size);
 	}
 	else
 	{
-		alloc = size + 1;
-		obj->ob_svar = (char*)Mem_Alloc(alloc);
-		if (bytes != NULL && size > 0)
-			memcpy(obj->ob_svar, bytes, size);
-		obj->ob_svar[size] = '\0'; // Trailing NULL byte (end of string)
+		obj = CrObject_NEWVAR(CrStringObject, &CrStringType, size);
+		if (obj == NULL)
+			return NULL;
 	}
-	VAROBJECT_SET_SIZE(obj, size);
-	obj->ob_alloc = alloc;
+	obj->ob_shash = -1;
+	obj->ob_sstate = SSTATE_NOT_INTERNED;
+	if (bytes != NULL && size > 0)
+		memcpy(obj->ob_svar, bytes, size);
+	obj->ob_svar[size] = '\0'; // Trailing NULL byte (end of string)
 	return (CrObject*)obj;
 }
 
@@ -104,6 +298,70 @@ CrObject* CrString_Concat(CrObject* a, CrObject* b)
 	return string_concat((CrStringObject*)a, b);
 }
 
+void CrString_ConcatInPlace(CrObject** pa, CrObject* b)
+{
+	CrObject* a = *pa;
+	if (a == NULL)
+		return;
+	if (!CrString_CheckExact(a) || !CrString_CheckExact(b))
+	{
+		CrError_SetString(CrExc_TypeError, "can only concat strings");
+		CrObject_SETREF(*pa, NULL);
+		return;
+	}
+
+	/* Nobody else can see the string, so it can simply grow */
+	if (Cr_REFCNT(a) == 1 && !CrString_CHECK_INTERNED(a) && Cr_SIZE(b) > 0)
+	{
+		Cr_size_t oldsize = Cr_SIZE(a);
+		if (_CrString_Resize(pa, oldsize + Cr_SIZE(b)) < 0)
+			return;
+		memcpy(((CrStringObject*)*pa)->ob_svar + oldsize, ((CrStringObject*)b)->ob_svar, Cr_SIZE(b));
+		return;
+	}
+
+	CrObject* result = string_concat((CrStringObject*)a, b);
+	CrObject_SETREF(*pa, result);
+}
+
+void CrString_ConcatAndDel(CrObject** pa, CrObject* b)
+{
+	CrString_ConcatInPlace(pa, b);
+	CrObject_XDECREF(b);
+}
+
+int _CrString_Resize(CrObject** pv, Cr_size_t newsize)
+{
+	CrStringObject* v = (CrStringObject*)*pv;
+	if (v == NULL || !CrString_CheckExact(v) || Cr_REFCNT(v) != 1 ||
+		CrString_CHECK_INTERNED(v) || newsize < 0)
+	{
+		*pv = NULL;
+		CrObject_XDECREF(v);
+		CrError_BadInternalCall();
+		return -1;
+	}
+
+	if (Cr_SIZE(v) == newsize)
+		return 0;
+
+	/* Stays consistent with the free list, which picks the list of a
+	   string by its size */
+	CrStringObject* nv = (CrStringObject*)Mem_ObjectRealloc(v, CrObject_VAR_SIZE(&CrStringType, newsize));
+	if (nv == NULL)
+	{
+		*pv = NULL;
+		CrObject_DECREF(v);
+		CrError_NoMemory();
+		return -1;
+	}
+	VAROBJECT_SET_SIZE(nv, newsize);
+	nv->ob_shash = -1;
+	nv->ob_svar[newsize] = '\0';
+	*pv = (CrObject*)nv;
+	return 0;
+}
+
 char* CrString_ToString(CrObject* str)
 {
 	if (!CrString_Check(str))
@@ -114,10 +372,197 @@ char* CrString_ToString(CrObject* str)
 	return ((CrStringObject*)str)->ob_svar;
 }
 
+void CrString_InternInPlace(CrObject** p)
+{
+	CrStringObject* s = (CrStringObject*)*p;
+	assert(s != NULL && CrString_Check(s));
+
+	if (!CrString_CheckExact(s) || CrString_CHECK_INTERNED(s))
+		return;
+
+	if (interned == NULL)
+	{
+		interned = CrDictObject_New();
+		if (interned == NULL)
+		{
+			CrError_Clear(); // Leave the string uninterned
+			return;
+		}
+	}
+
+	CrObject* t = CrDict_GetItem(interned, (CrObject*)s);
+	if (t != NULL)
+	{
+		CrObject_INCREF(t);
+		CrObject_SETREF(*p, t);
+		return;
+	}
+
+	/* The table keeps its own references */
+	if (CrDict_SetItem(interned, (CrObject*)s, (CrObject*)s) < 0)
+	{
+		CrError_Clear();
+		return;
+	}
+	s->ob_sstate = SSTATE_INTERNED;
+	CrObject_SET_IMMORTAL(s);
+}
+
+CrObject* CrString_InternFromStringAndSize(const char* bytes, Cr_size_t size)
+{
+	/* Look the bytes up before creating a string, so a name that is
+	   already interned costs no allocation */
+	Cr_hash_t hash = CrHash_Bytes(bytes, size);
+	if (interned != NULL)
+	{
+		CrObject* t = _CrDict_GetItemBytes(interned, bytes, size, hash);
+		if (t != NULL)
+		{
+			CrObject_INCREF(t);
+			return t;
+		}
+	}
+
+	CrObject* s = CrStringObject_FromStringAndSize(bytes, size);
+	if (s == NULL)
+		return NULL;
+	((CrStringObject*)s)->ob_shash = hash;
+	CrString_InternInPlace(&s);
+	return s;
+}
+
+CrObject* CrString_InternFromString(const char* bytes)
+{
+	return CrString_InternFromStringAndSize(bytes, strlen(bytes));
+}
+
+void CrString_ClearInterned()
+{
+	if (interned == NULL)
+		return;
+
+	/* Interned strings are immortal, so nothing counted the references
+	   to them. Leave them with just the table's key and value references,
+	   dropping the table then frees them. */
+	CrObject* key;
+	Cr_size_t pos = 0;
+	while (CrDict_Next(interned, &pos, &key, NULL))
+	{
+		((CrStringObject*)key)->ob_sstate = SSTATE_NOT_INTERNED;
+		Cr_REFCNT(key) = 2;
+	}
+
+	CrObject_DECREF(interned);
+	interned = NULL;
+}
+
+/*
+	String builder
+*/
+
+#define BUILDER_MINSIZE 32
+
+int CrStringBuilder_Init(CrStringBuilder* sb, Cr_size_t size_hint)
+{
+	sb->sb_len = 0;
+	sb->sb_str = CrStringObject_FromStringAndSize(NULL, size_hint < BUILDER_MINSIZE ? BUILDER_MINSIZE : size_hint);
+	return sb->sb_str != NULL ? 0 : -1;
+}
+
+/* Make room for 'size' more bytes, growing by half the capacity at a time */
+static int builder_reserve(CrStringBuilder* sb, Cr_size_t size)
+{
+	Cr_size_t capacity = Cr_SIZE(sb->sb_str);
+	if (sb->sb_len + size <= capacity)
+		return 0;
+
+	if (size > CR_SIZE_T_MAX - sb->sb_len)
+	{
+		CrError_NoMemory();
+		return -1;
+	}
+	Cr_size_t needed = sb->sb_len + size;
+	if (capacity <= (CR_SIZE_T_MAX - capacity) / 2)
+		capacity += capacity >> 1;
+	if (capacity < needed)
+		capacity = needed;
+	return _CrString_Resize(&sb->sb_str, capacity);
+}
+
+int CrStringBuilder_Append(CrStringBuilder* sb, const char* bytes, Cr_size_t size)
+{
+	if (builder_reserve(sb, size) < 0)
+		return -1;
+	memcpy(((CrStringObject*)sb->sb_str)->ob_svar + sb->sb_len, bytes, size);
+	sb->sb_len += size;
+	return 0;
+}
+
+int CrStringBuilder_AppendString(CrStringBuilder* sb, const char* bytes)
+{
+	return CrStringBuilder_Append(sb, bytes, strlen(bytes));
+}
+
+int CrStringBuilder_AppendObject(CrStringBuilder* sb, CrObject* str)
+{
+	if (!CrString_Check(str))
+	{
+		CrError_SetString(CrExc_TypeError, "can only append strings");
+		return -1;
+	}
+	return CrStringBuilder_Append(sb, ((CrStringObject*)str)->ob_svar, Cr_SIZE(str));
+}
+
+int CrStringBuilder_AppendChar(CrStringBuilder* sb, char c)
+{
+	if (builder_reserve(sb, 1) < 0)
+		return -1;
+	((CrStringObject*)sb->sb_str)->ob_svar[sb->sb_len++] = c;
+	return 0;
+}
+
+CrObject* CrStringBuilder_Finish(CrStringBuilder* sb)
+{
+	CrObject* result = sb->sb_str;
+	sb->sb_str = NULL;
+	if (result == NULL)
+		return NULL;
+
+	/* Trim the spare capacity, which the allocator can usually do
+	   without moving the string */
+	if (_CrString_Resize(&result, sb->sb_len) < 0)
+		return NULL;
+	sb->sb_len = 0;
+	return result;
+}
+
+void CrStringBuilder_Dealloc(CrStringBuilder* sb)
+{
+	CrObject_XDECREF(sb->sb_str);
+	sb->sb_str = NULL;
+	sb->sb_len = 0;
+}
+
+int CrString_ClearFreeList()
+{
+	int freed = numfree;
+	freelist_trim(0);
+	return freed;
+}
+
+void CrString_SetFreeListLimit(int limit)
+{
+	maxfree = limit < 0 ? 0 : limit;
+	freelist_trim(maxfree);
+}
+
 CrStatus CrString_InitTypes()
 {
 	if (CrType_Ready(&CrStringType) < 0)
 		return CrStatus_Error("can't init string type");
 
+	if (CrType_Ready(&CrStringIterType) < 0)
+		return CrStatus_Error("can't init string iterator type");
+
 	return CrStatus_Ok();
 }
@@ -4,18 +4,25 @@
 
 #include <core/status.h>
 
+/* The characters are stored inline after the header, ob_size bytes plus a
+   trailing NULL byte which the declared array already accounts for. */
 typedef struct _stringobject
 {
 	CrObject_VAR_HEAD;
-	size_t ob_alloc;
-	char* ob_svar;
+	Cr_hash_t ob_shash;			// Cached hash, -1 until computed
+	unsigned char ob_sstate;	// SSTATE_* interning state
+	char ob_svar[1];
 } CrStringObject;
 
-/* Type object */
+#define SSTATE_NOT_INTERNED	0
+#define SSTATE_INTERNED		1
+
+/* Type objects */
 extern CrTypeObject CrStringType;
+extern CrTypeObject CrStringIterType;
 
 /* Type check macros */
-#define CrString_Check(self) CrObject_TypeCheck(self, &CrStringType)
+#define CrString_Check(self) CrType_FastSubClass(Cr_TYPE(self), TPFLAGS_UNICODE_SUBCLASS)
 #define CrString_CheckExact(self) Cr_IS_TYPE(self, &CrStringType)
 
 /* Convert an array of bytes to a CrStringObject */
@@ -26,5 +33,82 @@ CrObject* CrStringObject_FromStringAndSize(const char* bytes, Cr_size_t size);
 CrObject* CrString_Concat(CrObject* a, CrObject* b);
 char* CrString_ToString(CrObject* str);
 
+/* Append 'b' to the string in *pa. If the caller holds the only reference
+   the string is grown in place, otherwise *pa is replaced by a new string.
+   On error *pa is released and set to NULL. */
+void CrString_ConcatInPlace(CrObject** pa, CrObject* b);
+
+/* Like CrString_ConcatInPlace(), and release 'b' as well */
+void CrString_ConcatAndDel(CrObject** pa, CrObject* b);
+
+/* Change the size of a string that is only referenced by the caller and
+   is not interned, resetting its cached hash. On error *pv is released and
+   set to NULL and -1 is returned. */
+int _CrString_Resize(CrObject** pv, Cr_size_t newsize);
+
+/* tp_richcompare of strings without the type checks, both arguments must
+   be strings */
+CrObject* _CrString_RichCompare(CrObject* a, CrObject* b, int op);
+
+/*
+ * String builder
+ *
+ * Builds a string piece by piece. The characters are written straight
+ * into a string object that over-allocates geometrically, so appending n
+ * bytes costs amortized O(n), and finishing hands that same object out
+ * after trimming it to size.
+ *
+ *	CrStringBuilder sb;
+ *	if (CrStringBuilder_Init(&sb, 0) < 0)
+ *		return NULL;
+ *	if (CrStringBuilder_AppendString(&sb, "name: ") < 0 ||
+ *		CrStringBuilder_AppendObject(&sb, name) < 0)
+ *	{
+ *		CrStringBuilder_Dealloc(&sb);
+ *		return NULL;
+ *	}
+ *	return CrStringBuilder_Finish(&sb);
+ */
+
+typedef struct _stringbuilder
+{
+	CrObject* sb_str;				// Buffer, its ob_size is the capacity
+	Cr_size_t sb_len;				// Bytes written so far
+} CrStringBuilder;
+
+int CrStringBuilder_Init(CrStringBuilder* sb, Cr_size_t size_hint);
+int CrStringBuilder_Append(CrStringBuilder* sb, const char* bytes, Cr_size_t size);
+int CrStringBuilder_AppendString(CrStringBuilder* sb, const char* bytes);
+int CrStringBuilder_AppendObject(CrStringBuilder* sb, CrObject* str);
+int CrStringBuilder_AppendChar(CrStringBuilder* sb, char c);
+
+/* Return the built string and reset the builder. */
+CrObject* CrStringBuilder_Finish(CrStringBuilder* sb);
+
+/* Discard a builder that will not be finished */
+void CrStringBuilder_Dealloc(CrStringBuilder* sb);
+
+/*
+ * Interning
+ *
+ * Interned strings are unique per content, so two interned strings are
+ * equal exactly when they are the same object. The intern table owns them
+ * until CrString_ClearInterned() runs at shutdown, which means a borrowed
+ * reference to an interned string stays valid for the life of the runtime.
+ */
+
+#define CrString_CHECK_INTERNED(op) (((CrStringObject*)(op))->ob_sstate != SSTATE_NOT_INTERNED)
+
+/* Replace *p with the interned string of equal value, interning *p itself
+   if there is none yet. *p must be a string owned by the caller. */
+void CrString_InternInPlace(CrObject** p);
+CrObject* CrString_InternFromString(const char* bytes);
+CrObject* CrString_InternFromStringAndSize(const char* bytes, Cr_size_t size);
+void CrString_ClearInterned();
+
+/* Free list management, returns the number of objects released */
+int CrString_ClearFreeList();
+void CrString_SetFreeListLimit(int limit);
+
 /* Runtime lifecycle */
 CrStatus CrString_InitTypes();
\ No newline at end of file
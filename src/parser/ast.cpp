@@ -6,7 +6,7 @@
 ast_generic_seq* CrAST_NewGenericSeq(Cr_size_t size, CrArena* arena)
 {
 	ast_generic_seq* seq = NULL;
-	size_t n = 0;
+	size_t n = (size ? (sizeof(void*) * (size - 1)) : 0);
 
 	// Check size is ok
 	if (size < 0 || (size && (((size_t)size - 1) > (SIZE_MAX / sizeof(void*)))))
@@ -30,7 +30,7 @@ ast_generic_seq* CrAST_NewGenericSeq(Cr_size_t size, CrArena* arena)
 ast_identifier_seq* CrAST_NewIdentifierSeq(Cr_size_t size, CrArena* arena)
 {
 	ast_identifier_seq* seq = NULL;
-	size_t n = 0;
+	size_t n = (size ? (sizeof(CrObject*) * (size - 1)) : 0);
 
 	// Check size is ok
 	if (size < 0 || (size && (((size_t)size - 1) > (SIZE_MAX / sizeof(void*)))))
@@ -54,7 +54,7 @@ ast_identifier_seq* CrAST_NewIdentifierSeq(Cr_size_t size, CrArena* arena)
 ast_int_seq* CrAST_NewIntSeq(Cr_size_t size, CrArena* arena)
 {
 	ast_int_seq* seq = NULL;
-	size_t n = 0;
+	size_t n = (size ? (sizeof(int) * (size - 1)) : 0);
 
 	// Check size is ok
 	if (size < 0 || (size && (((size_t)size - 1) > (SIZE_MAX / sizeof(void*)))))
@@ -78,7 +78,7 @@ ast_int_seq* CrAST_NewIntSeq(Cr_size_t size, CrArena* arena)
 ast_expr_seq* CrAST_NewExprSeq(Cr_size_t size, CrArena* arena)
 {
 	ast_expr_seq* seq = NULL;
-	size_t n = 0;
+	size_t n = (size ? (sizeof(expr_type) * (size - 1)) : 0);
 
 	// Check size is ok
 	if (size < 0 || (size && (((size_t)size - 1) > (SIZE_MAX / sizeof(void*)))))
@@ -1,6 +1,8 @@
 #include "generator.h"
 
 #include <core/error.h>
+#include <core/ctype.h>
+#include <core/dtoa.h>
 #include <core/errorcode.h>
 #include <objects/stringobject.h>
 #include <objects/intobject.h>
@@ -98,6 +100,57 @@ CrObject* CrGen_Memo_GetStats()
 	return ret;
 }
 
+/*
+*	Rule results are memoized in an open addressing table keyed by the
+*	token the rule was tried at and the rule type. It lives outside the
+*	arena so the old table can be freed when it is doubled at half full,
+*	CrParser_Free() frees the last one.
+*/
+
+#define MEMO_MIN_SIZE 256
+
+// Find the entry for (mark, type), or the empty slot it belongs in
+static Memo* memo_lookup(Parser* p, int mark, int type)
+{
+	size_t mask = (size_t)p->memo_size - 1;
+	size_t i = ((size_t)mark * 0x9E3779B1u + (size_t)type) & mask;
+	for (;;)
+	{
+		Memo* m = &p->memo[i];
+		if (m->type == 0 || (m->mark == mark && m->type == type))
+		{
+			return m;
+		}
+		i = (i + 1) & mask;
+	}
+}
+
+static int memo_resize(Parser* p)
+{
+	Memo* old = p->memo;
+	int oldsize = p->memo_size;
+	int newsize = (oldsize == 0) ? MEMO_MIN_SIZE : oldsize * 2;
+
+	Memo* memo = (Memo*)Mem_Calloc(newsize, sizeof(Memo));
+	if (memo == NULL)
+	{
+		CrError_NoMemory();
+		return -1;
+	}
+
+	p->memo = memo;
+	p->memo_size = newsize;
+	for (int i = 0; i < oldsize; i++)
+	{
+		if (old[i].type != 0)
+		{
+			*memo_lookup(p, old[i].mark, old[i].type) = old[i];
+		}
+	}
+	Mem_Free(old);
+	return 0;
+}
+
 int CrGen_IsMemoized(Parser* p, int type, void* pres)
 {
 	if (p->mark == p->fill)
@@ -109,60 +162,52 @@ int CrGen_IsMemoized(Parser* p, int type, void* pres)
 		}
 	}
 
-	Token* t = p->tokens[p->mark];
+	if (p->memo_size == 0)
+		return 0;
+
+	Memo* m = memo_lookup(p, p->mark, type);
+	if (m->type == 0)
+		return 0;
 
-	for (Memo* m = t->memo; m != NULL; m = m->next)
+	if (0 <= type && type < NSTATISTICS)
 	{
-		if (m->type == type)
+		long count = m->end - p->mark;
+		// A memoized negative result counts for one.
+		if (count <= 0)
 		{
-			if (0 <= type && type < NSTATISTICS)
-			{
-				long count = m->mark - p->mark;
-				// A memoized negative result counts for one.
-				if (count <= 0)
-				{
-					count = 1;
-				}
-				memo_statistics[type] += count;
-			}
-			p->mark = m->mark;
-			*(void**)(pres) = m->node;
-			return 1;
+			count = 1;
 		}
+		memo_statistics[type] += count;
 	}
-	return 0;
+	p->mark = m->end;
+	*(void**)(pres) = m->node;
+	return 1;
 }
 
 // Here, mark is the start of the node, while p->mark is the end.
 // If node==NULL, they should be the same.
 int CrGen_Memo_Insert(Parser* p, int mark, int type, void* node)
 {
-	// Insert in front
-	Memo* m = (Memo*)Mem_Alloc(sizeof(Memo));
-	if (m == NULL)
+	assert(type != 0);
+	if ((p->memo_fill + 1) * 2 > p->memo_size && memo_resize(p) < 0)
 		return -1;
-	m->type = type;
+
+	Memo* m = memo_lookup(p, mark, type);
+	if (m->type == 0)
+	{
+		m->type = type;
+		m->mark = mark;
+		p->memo_fill++;
+	}
 	m->node = node;
-	m->mark = p->mark;
-	m->next = p->tokens[mark]->memo;
-	p->tokens[mark]->memo = m;
+	m->end = p->mark;
 	return 0;
 }
 
 // Like CrGen_Memo_Insert(), but updates an existing node if found.
+// The table holds one entry per key, so inserting always does that.
 int CrGen_Memo_Update(Parser* p, int mark, int type, void* node)
 {
-	for (Memo* m = p->tokens[mark]->memo; m != NULL; m = m->next)
-	{
-		if (m->type == type)
-		{
-			// Update existing node
-			m->node = node;
-			m->mark = p->mark;
-			return 0;
-		}
-	}
-	// Insert new node
 	return CrGen_Memo_Insert(p, mark, type, node);
 }
 
@@ -230,18 +275,11 @@ static int CrGen_TokenizerError(Parser* p)
 static int CrGen_GetKeywordOrName(Parser* p, const char* name, int name_len)
 {
 	assert(name_len > 0);
-	if (name_len >= p->keywordListSize ||
-		p->keywords[name_len] == NULL ||
-		p->keywords[name_len]->type == TOK_UNKNOWN)
-	{
-		return TOK_NAME;
-	}
-	for (KeywordToken* k = p->keywords[name_len]; k != NULL && k->type != -1; k++)
+	// A name can only be the keyword in its own slot
+	const KeywordSlot* k = &p->keywords[CrParser_KeywordHash(name, name_len)];
+	if (k->length == name_len && memcmp(k->name, name, name_len) == 0)
 	{
-		if (strncmp(k->name, name, name_len) == 0)
-		{
-			return k->type;
-		}
+		return k->type;
 	}
 	return TOK_NAME;
 }
@@ -274,6 +312,10 @@ int CrGen_FillToken(Parser* p)
 		p->parsing_started = 1;
 	}
 
+	/* Tokens are stored in contiguous chunks. Every chunk is as large as
+	   all the previous ones together, so they start at index 0 and then at
+	   TOKEN_CHUNK_SIZE times each power of two. A token never moves once
+	   it is read, rules can keep a Token* while more tokens are filled. */
 	if (p->fill == p->size)
 	{
 		int newsize = p->size * 2;
@@ -285,25 +327,23 @@ int CrGen_FillToken(Parser* p)
 		}
 		p->tokens = new_tokens;
 
+		Token* chunk = (Token*)Mem_Calloc(newsize - p->size, sizeof(Token));
+		if (chunk == NULL)
+		{
+			CrError_NoMemory();
+			return TOK_UNKNOWN;
+		}
 		for (int i = p->size; i < newsize; i++)
 		{
-			p->tokens[i] = (Token*)Mem_Alloc(sizeof(Token));
-			if (p->tokens[i] == NULL)
-			{
-				p->size = i; // Needed, in order to cleanup correctly after parser fails
-				CrError_NoMemory();
-				return TOK_UNKNOWN;
-			}
-			memset(p->tokens[i], '\0', sizeof(Token));
+			p->tokens[i] = &chunk[i - p->size];
 		}
 		p->size = newsize;
 	}
 
 	Token* t = p->tokens[p->fill];
 	t->type = static_cast<token_type>((type == TOK_NAME) ? CrGen_GetKeywordOrName(p, start, (int)(end - start)) : type);
-	t->value = CrStringObject_FromStringAndSize(start, end - start);
-	if (t->value == NULL)
-		return TOK_UNKNOWN;
+	t->start = (start != NULL) ? start - p->tok->buf : 0;
+	t->length = (start != NULL && end != NULL) ? end - start : 0;
 
 	int lineno = type == TOK_STRING ? p->tok->first_lineno : p->tok->lineno;
 	const char* line_start = type == TOK_STRING ? p->tok->multi_line_start : p->tok->line_start;
@@ -403,7 +443,10 @@ Token* CrGen_GetLastNonWhitespaceToken(Parser* p)
 	for (int m = p->mark - 1; m >= 0; m--)
 	{
 		token = p->tokens[m];
-		if (token->type != TOK_ENDMARKER && (token->type < TOK_NEWLINE || token->type > TOK_DEDENT))
+		/* NEWLINE, INDENT and DEDENT aren't adjacent in token_type, so a
+		   range check would treat every token as whitespace */
+		if (token->type != TOK_ENDMARKER && token->type != TOK_NEWLINE &&
+			token->type != TOK_INDENT && token->type != TOK_DEDENT)
 		{
 			break;
 		}
@@ -418,72 +461,71 @@ void* CrGen_StringToken(Parser* p)
 
 static CrObject* parse_number_raw(const char* s)
 {
+	const char* p;
 	const char* end;
-	long x;
-	double dx;
+	Cr_int64_t x = 0;
 
 	assert(s != NULL);
-	errno = 0;
-	end = s + strlen(s) - 1;
-	if (s[0] == '0')
+	if (s[0] == '0' && s[1] != '\0' && strchr("xXoObB", s[1]) != NULL)
 	{
+		/* Prefixed literals are always ints */
+		return CrIntObject_FromString(s, 0);
+	}
 
-		x = (long)strtoul(s, (char**)&end, 0);
-		if (x < 0 && errno == 0)
-		{
-			return CrIntObject_FromString(s, 0);
-		}
+	/* Up to 18 decimal digits can't overflow, accumulate them directly */
+	for (p = s; Cr_ISDIGIT(*p) && p - s < 18; p++)
+	{
+		x = x * 10 + (*p - '0');
 	}
-	else
+	if (*p == '\0')
 	{
-		x = strtol(s, (char**)&end, 0);
+		return CrIntObject_FromLongLong(x);
 	}
-	if (*end == '\0')
+	while (Cr_ISDIGIT(*p))
 	{
-		if (errno != 0)
-		{
-			return CrIntObject_FromString(s, 0);
-		}
-		return CrIntObject_FromInt(x);
+		p++;
 	}
-	dx = strtod(s, NULL);
-	if (dx == -1.0 && CrError_Occurred())
+	if (*p == '\0')
 	{
-		return NULL;
+		return CrIntObject_FromString(s, 10);
 	}
-	return CrFloatObject_FromDouble(dx);
+
+	/* Anything else is a float */
+	return CrFloatObject_FromDouble(Cr_StringToDouble(s, &end));
 }
 
-static CrObject* parse_number(const char* s)
+/* Parse the text of a NUMBER token, which is not NUL terminated, dropping
+   any underscores on the way */
+static CrObject* parse_number(const char* s, Cr_size_t len)
 {
-	char* dup;
+	char small[64];
+	char* buf = small;
 	char* end;
 	CrObject* result = NULL;
 
-	assert(s != NULL);
-
-	if (strchr(s, '_') == NULL)
-	{
-		return parse_number_raw(s);
-	}
-	/* Create a duplicate without underscores. */
-	dup = (char*)Mem_Alloc(strlen(s) + 1);
-	if (dup == NULL)
+	if (len >= (Cr_size_t)sizeof(small))
 	{
-		CrError_NoMemory();
-		return NULL;
+		buf = (char*)Mem_Alloc(len + 1);
+		if (buf == NULL)
+		{
+			CrError_NoMemory();
+			return NULL;
+		}
 	}
-	end = dup;
-	for (; *s; s++)
+	end = buf;
+	for (Cr_size_t i = 0; i < len; i++)
 	{
-		if (*s != '_')
+		if (s[i] != '_')
 		{
-			*end++ = *s;
+			*end++ = s[i];
 		}
 	}
 	*end = '\0';
-	result = parse_number_raw(dup);
-	Mem_Free(dup);
+	result = parse_number_raw(buf);
+	if (buf != small)
+	{
+		Mem_Free(buf);
+	}
 	return result;
 }
 
@@ -493,14 +535,7 @@ expr_type CrGen_NumberToken(Parser* p)
 	if (t == NULL)
 		return NULL;
 
-	char* raw_num = CrString_ToString(t->value);
-	if (raw_num == NULL)
-	{
-		p->error_indicator = 1;
-		return NULL;
-	}
-
-	CrObject* num = parse_number(raw_num);
+	CrObject* num = parse_number(CrGen_TOKEN_TEXT(p, t), t->length);
 	if (num == NULL)
 	{
 		p->error_indicator = 1;
@@ -522,12 +557,7 @@ static expr_type CrGen_NameFromToken(Parser* p, Token* t)
 	if (t == NULL) {
 		return NULL;
 	}
-	const char* s = CrString_ToString(t->value);
-	if (!s) {
-		p->error_indicator = 1;
-		return NULL;
-	}
-	CrObject* id = CrGen_NewIdentifier(p, s);
+	CrObject* id = CrGen_NewIdentifier(p, CrGen_TOKEN_TEXT(p, t), t->length);
 	if (id == NULL) {
 		p->error_indicator = 1;
 		return NULL;
@@ -698,21 +728,19 @@ error:
 	return result;
 }
 
-CrObject* CrGen_NewIdentifier(Parser* p, const char* n)
+CrObject* CrGen_NewIdentifier(Parser* p, const char* n, Cr_size_t size)
 {
-	CrObject* id = CrStringObject_FromString(n);
+	CrObject* id = CrString_InternFromStringAndSize(n, size);
 	if (!id)
-		goto error;
-
-	if (CrArena_AddCrObject(p->arena, id) < 0)
 	{
-		CrObject_DECREF(id);
-		goto error;
+		p->error_indicator = 1;
+		return NULL;
 	}
+
+	/* The intern table keeps identifiers alive, so unlike other
+	   objects they need not be added to the arena */
+	CrObject_DECREF(id);
 	return id;
-error:
-	p->error_indicator = 1;
-	return NULL;
 }
 
 CrObject* CrGen_NewTypeComment(Parser* p, Token* tc)
@@ -720,11 +748,7 @@ CrObject* CrGen_NewTypeComment(Parser* p, Token* tc)
 	CrObject* tco;
 	if (tc == NULL)
 		return NULL;
-	const char* str = CrString_ToString(tc->value);
-	if (str == NULL)
-		goto error;
-
-	tco = CrStringObject_FromString(str);
+	tco = CrStringObject_FromStringAndSize(CrGen_TOKEN_TEXT(p, tc), tc->length);
 	if (tco == NULL)
 		goto error;
 	if (CrArena_AddCrObject(p->arena, tco) < 0)
@@ -34,6 +34,10 @@ int CrGen_Memo_Update(Parser* p, int mark, int type, void* node);
 
 /* Tokenizer functions */
 
+/* The text of a token, which is not NUL terminated. It points into the
+   tokenizer buffer, so it is only good until the next token is read. */
+#define CrGen_TOKEN_TEXT(p, t) ((p)->tok->buf + (t)->start)
+
 int CrGen_FillToken(Parser* p);
 Token* CrGen_ExpectToken(Parser* p, int type);
 Token* CrGen_ExpectForcedToken(Parser* p, int type);
@@ -59,5 +63,5 @@ mod_type CrGen_ASTFromFileObject(std::ifstream* fp, CrObject* filename, int mode
 
 /* Misc functions */
 
-CrObject* CrGen_NewIdentifier(Parser* p, const char* n);
+CrObject* CrGen_NewIdentifier(Parser* p, const char* n, Cr_size_t size);
 CrObject* CrGen_NewTypeComment(Parser* p, Token* tc);
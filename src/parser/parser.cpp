@@ -38,54 +38,55 @@ static inline void* CHECK_CALL(Parser* p, void* result)
 
 #define EXTRA start_lineno, start_col_offset, end_lineno, end_col_offset, p->arena
 
-static const int keywordListSize = KEYWORD_COUNT;
-static KeywordToken keywords[][KEYWORDS_MAX] = {
-	{ // 0
-		{NULL, TOK_UNKNOWN}
-	},
-	{ // 1
-		{NULL, TOK_UNKNOWN}
-	},
-	{ // 2
-		{"if", TOK_IF},
-		{"do", TOK_DO},
-		{"is", TOK_IS},
-		{NULL, TOK_UNKNOWN}
-	},
-	{ // 3
-		{"for", TOK_FOR},
-		{"not", TOK_NOT},
-		{NULL, TOK_UNKNOWN}},
-	{ // 4
-		{"else", TOK_ELSE},
-		{"func", TOK_FUNC},
-		{"Null", TOK_NULL},
-		{"True", TOK_TRUE},
-		{"from", TOK_FROM},
-		{NULL, TOK_UNKNOWN}
-	},
-	{ // 5
-		{"while", TOK_WHILE},
-		{"class", TOK_CLASS},
-		{"async", TOK_ASYNC},
-		{"await", TOK_AWAIT},
-		{"False", TOK_FALSE},
-		{"yield", TOK_YIELD},
-		{NULL, TOK_UNKNOWN}
-	},
-	{ // 6
-		{NULL, TOK_UNKNOWN}
-	},
-	{ // 7
-		{NULL, TOK_UNKNOWN}
-	},
-	{ // 8
-		{NULL, TOK_UNKNOWN}
-	},
-	{ // 9
-		{"extension", TOK_EXTENSION},
-		{NULL, TOK_UNKNOWN}
-	} };
+static constexpr KeywordToken keyword_list[] = {
+	{"if", TOK_IF},
+	{"do", TOK_DO},
+	{"is", TOK_IS},
+	{"for", TOK_FOR},
+	{"not", TOK_NOT},
+	{"else", TOK_ELSE},
+	{"func", TOK_FUNC},
+	{"Null", TOK_NULL},
+	{"True", TOK_TRUE},
+	{"from", TOK_FROM},
+	{"while", TOK_WHILE},
+	{"class", TOK_CLASS},
+	{"async", TOK_ASYNC},
+	{"await", TOK_AWAIT},
+	{"False", TOK_FALSE},
+	{"yield", TOK_YIELD},
+	{"extension", TOK_EXTENSION},
+};
+
+/* The keyword list laid out by CrParser_KeywordHash() */
+typedef struct _keywordtable
+{
+	KeywordSlot slots[KEYWORD_HASH_SIZE];
+	int collisions;
+} KeywordTable;
+
+static constexpr KeywordTable keyword_table_build()
+{
+	KeywordTable table = {};
+	for (const KeywordToken& k : keyword_list)
+	{
+		int length = 0;
+		while (k.name[length] != '\0')
+			length++;
+
+		KeywordSlot& slot = table.slots[CrParser_KeywordHash(k.name, length)];
+		if (slot.name != NULL)
+			table.collisions++;
+		slot.name = k.name;
+		slot.length = length;
+		slot.type = k.type;
+	}
+	return table;
+}
+
+static constexpr KeywordTable keyword_table = keyword_table_build();
+static_assert(keyword_table.collisions == 0,
+	"two keywords share a slot, change the multipliers in CrParser_KeywordHash()");
 
 /* Helper functions */
 
@@ -215,8 +216,42 @@ static void* gatherrule_219(Parser* p);
 // file: statements? $
 static mod_type rule_file_mode(Parser* p)
 {
-	CrError_SetString(CrExc_SystemError, "parser rule not implemented");
-	return NULL;
+	RULE_HEAD();
+
+	mod_type result = NULL;
+	int mark = p->mark;
+	{ // [statements] ENDMARKER
+		if (p->error_indicator)
+		{
+			p->level--;
+			return NULL;
+		}
+		CrParser_PrintTest("file_mode", "[statements] ENDMARKER");
+		ast_stmt_seq* stmt_sq;
+		Token* endmarker_var;
+		if (
+			(stmt_sq = rule_statements(p), !p->error_indicator) // [statements]
+			&&
+			(endmarker_var = CrGen_ExpectToken(p, TOK_ENDMARKER)) // token = 'ENDMARKER'
+			)
+		{
+			CrParser_PrintSuccess("file_mode", "[statements] ENDMARKER");
+			result = CrAST_Module(stmt_sq, NULL, p->arena);
+			if (result == NULL && CrError_Occurred())
+			{
+				p->error_indicator = 1;
+				p->level--;
+				return NULL;
+			}
+			goto done;
+		}
+		p->mark = mark;
+		CrParser_PrintFail("file_mode", "[statements] ENDMARKER");
+	}
+	result = NULL;
+done:
+	p->level--;
+	return result;
 }
 
 // interactive: statement_newline
@@ -3767,31 +3802,14 @@ done:
 // End of Definitions
 //
 
-static int newline_in_string(Parser* p, const char* cur)
-{
-	for (const char* c = cur; c >= p->tok->buf; c--)
-	{
-		if (*c == '\'' || *c == '"')
-		{
-			return 1;
-		}
-	}
-	return 0;
-}
-
 /* Check that the source for a single input statement really is a single
    statement by looking at what is left in the buffer after parsing.
-   Trailing whitespace and comments are OK. */
+   Trailing whitespace and comments are OK. Interactive input keeps every
+   line of the statement in the buffer, so only the part after tok->cur
+   is looked at. */
 static int bad_single_statement(Parser* p)
 {
-	const char* cur = strchr(p->tok->buf, '\n');
-
-	/* Newlines are allowed if preceded by a line continuation character
-	   or if they appear inside a string. */
-	if (!cur || (cur != p->tok->buf && *(cur - 1) == '\\') || newline_in_string(p, cur))
-	{
-		return 0;
-	}
+	const char* cur = p->tok->cur;
 	char c = *cur;
 
 	for (;;)
@@ -3821,8 +3839,9 @@ static int bad_single_statement(Parser* p)
 
 static void parser_reset_state(Parser* p)
 {
-	for (int i = 0; i < p->fill; i++)
-		p->tokens[i]->memo = NULL;
+	if (p->memo != NULL)
+		memset(p->memo, 0, p->memo_size * sizeof(Memo));
+	p->memo_fill = 0;
 	p->mark = 0;
 }
 
@@ -3870,26 +3889,31 @@ Parser* CrParser_New(TokState* tok, int startRule, int* error_code, CrArena* are
 	p->arena = arena;
 
 	p->tok = tok;
-	p->tokens = (Token**)Mem_Alloc(sizeof(Token*));
+	p->tokens = (Token**)Mem_Alloc(TOKEN_CHUNK_SIZE * sizeof(Token*));
 	if (!p->tokens)
 	{
-		Mem_Free(p->tokens);
+		Mem_Free(p);
 		CrError_SetString(CrExc_MemoryError, "out of memory");
 		return NULL;
 	}
-	p->tokens[0] = (Token*)Mem_Calloc(1, sizeof(Token));
-	if (!p->tokens)
+	Token* chunk = (Token*)Mem_Calloc(TOKEN_CHUNK_SIZE, sizeof(Token));
+	if (!chunk)
 	{
-		Mem_Free(p->tokens[0]);
 		Mem_Free(p->tokens);
+		Mem_Free(p);
 		CrError_SetString(CrExc_MemoryError, "out of memory");
 		return NULL;
 	}
-	p->size = 1;
+	for (int i = 0; i < TOKEN_CHUNK_SIZE; i++)
+		p->tokens[i] = &chunk[i];
+	p->size = TOKEN_CHUNK_SIZE;
 	p->fill = 0;
 
-	p->keywordListSize = keywordListSize;
-	p->keywords = keywords;
+	p->memo = NULL;
+	p->memo_size = 0;
+	p->memo_fill = 0;
+
+	p->keywords = keyword_table.slots;
 
 	p->mark = 0;
 	p->level = 0;
@@ -3933,10 +3957,13 @@ void* CrParser_Parse(Parser* p)
 
 void CrParser_Free(Parser* p)
 {
-	for (int i = 0; i < p->size; i++)
+	// Free the token chunks, see CrGen_FillToken()
+	Mem_Free(p->tokens[0]);
+	for (int i = TOKEN_CHUNK_SIZE; i < p->size; i *= 2)
 	{
 		Mem_Free(p->tokens[i]);
 	}
 	Mem_Free(p->tokens);
+	Mem_Free(p->memo);
 	Mem_Free(p);
 }
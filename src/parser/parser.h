@@ -4,19 +4,46 @@
 #include <parser/ast.h>
 #include <parser/tokenizer.h>
 
-#define KEYWORD_COUNT 10
-#define KEYWORDS_MAX 10
+#define KEYWORD_HASH_SIZE 32 // Slots in the keyword table, a power of two
+
+#define TOKEN_CHUNK_SIZE 64 // Number of tokens in the first chunk, each later chunk doubles the total
 
 /*
  *	Parser
 */
 
+/* An entry in the parser's memo table, keyed by (mark, type) */
+typedef struct _memo
+{
+	int type;			// Rule type, 0 for an empty slot
+	int mark;			// Token the rule was tried at
+	int end;			// Token after the rule's result
+	void* node;
+} Memo;
+
 typedef struct _keywordtoken
 {
 	const char* name;
 	token_type type;
 } KeywordToken;
 
+/* A slot of the keyword table, name is NULL if the slot is empty */
+typedef struct _keywordslot
+{
+	const char* name;
+	int length;
+	token_type type;
+} KeywordSlot;
+
+/* Hash for the keyword table. It only looks at the length and the first
+   and last characters, parser.cpp checks at compile time that no two
+   keywords land in the same slot. */
+static inline constexpr unsigned int CrParser_KeywordHash(const char* name, int length)
+{
+	return ((unsigned char)name[0] * 3u + (unsigned char)name[length - 1] * 17u + (unsigned int)length) &
+		(KEYWORD_HASH_SIZE - 1);
+}
+
 #if 0
 #define PARSE_YIELD_IS_KEYWORD        0x0001
 #endif
@@ -52,11 +79,13 @@ typedef struct _parser
 	CrArena* arena;
 
 	TokState* tok;
-	Token** tokens;
+	Token** tokens;		// Index of the token chunks, see CrGen_FillToken()
 	int fill, size;
 
-	int keywordListSize;
-	KeywordToken(*keywords)[KEYWORD_COUNT];
+	Memo* memo;			// Open addressing table, see CrGen_IsMemoized()
+	int memo_size, memo_fill;
+
+	const KeywordSlot* keywords;	// KEYWORD_HASH_SIZE slots indexed by CrParser_KeywordHash()
 
 	int mark;
 	int level;
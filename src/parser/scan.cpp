@@ -0,0 +1,323 @@
+#include "scan.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || \
+	(defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#	define SCAN_SSE2
+#	define SCAN_AVX2
+#	include <immintrin.h>
+#endif
+
+#ifdef _MSC_VER
+#	include <intrin.h>
+#endif
+
+/* GCC and Clang only emit AVX2 code in functions marked for it, MSVC
+   accepts the intrinsics anywhere */
+#if defined(__GNUC__) || defined(__clang__)
+#	define SCAN_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#	define SCAN_TARGET_AVX2
+#endif
+
+typedef struct _scanfuncs
+{
+	const char* (*identifier)(const char* s, const char* end);
+	const char* (*digits)(const char* s, const char* end);
+	const char* (*blanks)(const char* s, const char* end);
+	const char* (*string_body)(const char* s, const char* end, char quote);
+} ScanFuncs;
+
+static inline int is_identifier_ascii(unsigned char c)
+{
+	return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+		(c >= '0' && c <= '9') || c == '_';
+}
+
+static inline int is_blank(unsigned char c)
+{
+	return c == ' ' || c == '\t' || c == '\014';
+}
+
+/*
+	Portable loops, also used for the tails of the vector versions
+*/
+
+static const char* scalar_identifier(const char* s, const char* end)
+{
+	while (s < end && is_identifier_ascii(CR_CHARMASK(*s)))
+		s++;
+	return s;
+}
+
+static const char* scalar_digits(const char* s, const char* end)
+{
+	while (s < end && *s >= '0' && *s <= '9')
+		s++;
+	return s;
+}
+
+static const char* scalar_blanks(const char* s, const char* end)
+{
+	while (s < end && is_blank(CR_CHARMASK(*s)))
+		s++;
+	return s;
+}
+
+static const char* scalar_string_body(const char* s, const char* end, char quote)
+{
+	while (s < end && *s != quote && *s != '\\' && *s != '\n')
+		s++;
+	return s;
+}
+
+static const ScanFuncs scan_scalar = {
+	scalar_identifier,
+	scalar_digits,
+	scalar_blanks,
+	scalar_string_body,
+};
+
+#ifdef SCAN_SSE2
+
+/* Index of the lowest set bit, x must not be 0 */
+static inline int scan_ctz(unsigned int x)
+{
+#ifdef _MSC_VER
+	unsigned long i;
+	_BitScanForward(&i, x);
+	return (int)i;
+#else
+	return __builtin_ctz(x);
+#endif
+}
+
+/*
+	SSE2
+
+	Each function builds a mask with a bit set for every character that
+	ends the run and returns at the lowest one. Bytes are compared as
+	signed, so non-ASCII bytes are negative and never fall in a range.
+*/
+
+static inline __m128i sse2_in_range(__m128i v, char lo, char hi)
+{
+	return _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8(lo - 1)),
+		_mm_cmpgt_epi8(_mm_set1_epi8(hi + 1), v));
+}
+
+static const char* sse2_identifier(const char* s, const char* end)
+{
+	for (; end - s >= 16; s += 16)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i*)s);
+		// Setting bit 5 folds upper case letters onto lower case
+		__m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+		__m128i ok = _mm_or_si128(
+			_mm_or_si128(sse2_in_range(lower, 'a', 'z'), sse2_in_range(v, '0', '9')),
+			_mm_cmpeq_epi8(v, _mm_set1_epi8('_')));
+		unsigned int stop = (unsigned int)_mm_movemask_epi8(ok) ^ 0xFFFF;
+		if (stop)
+			return s + scan_ctz(stop);
+	}
+	return scalar_identifier(s, end);
+}
+
+static const char* sse2_digits(const char* s, const char* end)
+{
+	for (; end - s >= 16; s += 16)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i*)s);
+		unsigned int stop = (unsigned int)_mm_movemask_epi8(sse2_in_range(v, '0', '9')) ^ 0xFFFF;
+		if (stop)
+			return s + scan_ctz(stop);
+	}
+	return scalar_digits(s, end);
+}
+
+static const char* sse2_blanks(const char* s, const char* end)
+{
+	for (; end - s >= 16; s += 16)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i*)s);
+		__m128i ok = _mm_or_si128(
+			_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\t'))),
+			_mm_cmpeq_epi8(v, _mm_set1_epi8('\014')));
+		unsigned int stop = (unsigned int)_mm_movemask_epi8(ok) ^ 0xFFFF;
+		if (stop)
+			return s + scan_ctz(stop);
+	}
+	return scalar_blanks(s, end);
+}
+
+static const char* sse2_string_body(const char* s, const char* end, char quote)
+{
+	for (; end - s >= 16; s += 16)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i*)s);
+		__m128i hit = _mm_or_si128(
+			_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(quote)), _mm_cmpeq_epi8(v, _mm_set1_epi8('\\'))),
+			_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')));
+		unsigned int stop = (unsigned int)_mm_movemask_epi8(hit);
+		if (stop)
+			return s + scan_ctz(stop);
+	}
+	return scalar_string_body(s, end, quote);
+}
+
+static const ScanFuncs scan_sse2 = {
+	sse2_identifier,
+	sse2_digits,
+	sse2_blanks,
+	sse2_string_body,
+};
+
+#endif /* SCAN_SSE2 */
+
+#ifdef SCAN_AVX2
+
+/*
+	AVX2, the same as SSE2 over 32 characters. Runs shorter than that
+	are left to the SSE2 loops.
+*/
+
+SCAN_TARGET_AVX2
+static inline __m256i avx2_in_range(__m256i v, char lo, char hi)
+{
+	return _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8(lo - 1)),
+		_mm256_cmpgt_epi8(_mm256_set1_epi8(hi + 1), v));
+}
+
+SCAN_TARGET_AVX2
+static const char* avx2_identifier(const char* s, const char* end)
+{
+	for (; end - s >= 32; s += 32)
+	{
+		__m256i v = _mm256_loadu_si256((const __m256i*)s);
+		__m256i lower = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+		__m256i ok = _mm256_or_si256(
+			_mm256_or_si256(avx2_in_range(lower, 'a', 'z'), avx2_in_range(v, '0', '9')),
+			_mm256_cmpeq_epi8(v, _mm256_set1_epi8('_')));
+		unsigned int stop = ~(unsigned int)_mm256_movemask_epi8(ok);
+		if (stop)
+			return s + scan_ctz(stop);
+	}
+	return sse2_identifier(s, end);
+}
+
+SCAN_TARGET_AVX2
+static const char* avx2_digits(const char* s, const char* end)
+{
+	for (; end - s >= 32; s += 32)
+	{
+		__m256i v = _mm256_loadu_si256((const __m256i*)s);
+		unsigned int stop = ~(unsigned int)_mm256_movemask_epi8(avx2_in_range(v, '0', '9'));
+		if (stop)
+			return s + scan_ctz(stop);
+	}
+	return sse2_digits(s, end);
+}
+
+SCAN_TARGET_AVX2
+static const char* avx2_blanks(const char* s, const char* end)
+{
+	for (; end - s >= 32; s += 32)
+	{
+		__m256i v = _mm256_loadu_si256((const __m256i*)s);
+		__m256i ok = _mm256_or_si256(
+			_mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t'))),
+			_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\014')));
+		unsigned int stop = ~(unsigned int)_mm256_movemask_epi8(ok);
+		if (stop)
+			return s + scan_ctz(stop);
+	}
+	return sse2_blanks(s, end);
+}
+
+SCAN_TARGET_AVX2
+static const char* avx2_string_body(const char* s, const char* end, char quote)
+{
+	for (; end - s >= 32; s += 32)
+	{
+		__m256i v = _mm256_loadu_si256((const __m256i*)s);
+		__m256i hit = _mm256_or_si256(
+			_mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(quote)), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\\'))),
+			_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')));
+		unsigned int stop = (unsigned int)_mm256_movemask_epi8(hit);
+		if (stop)
+			return s + scan_ctz(stop);
+	}
+	return sse2_string_body(s, end, quote);
+}
+
+static const ScanFuncs scan_avx2 = {
+	avx2_identifier,
+	avx2_digits,
+	avx2_blanks,
+	avx2_string_body,
+};
+
+/* AVX2 needs the instructions and an OS that saves the YMM registers */
+static int cpu_has_avx2()
+{
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7)
+		return 0;
+	__cpuid(info, 1);
+	// OSXSAVE and AVX
+	if ((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0)
+		return 0;
+	if ((_xgetbv(0) & 6) != 6)
+		return 0;
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif /* SCAN_AVX2 */
+
+/*
+	Dispatch
+*/
+
+static const ScanFuncs* scan_funcs = NULL;
+
+static const ScanFuncs* scan_select()
+{
+	/* Every thread picks the same table, so a race here is harmless */
+#if defined(SCAN_AVX2)
+	if (cpu_has_avx2())
+		return scan_funcs = &scan_avx2;
+#endif
+#if defined(SCAN_SSE2)
+	return scan_funcs = &scan_sse2;
+#else
+	return scan_funcs = &scan_scalar;
+#endif
+}
+
+#define SCAN_FUNCS() (scan_funcs != NULL ? scan_funcs : scan_select())
+
+const char* _CrScan_Identifier(const char* s, const char* end)
+{
+	return SCAN_FUNCS()->identifier(s, end);
+}
+
+const char* _CrScan_Digits(const char* s, const char* end)
+{
+	return SCAN_FUNCS()->digits(s, end);
+}
+
+const char* _CrScan_Blanks(const char* s, const char* end)
+{
+	return SCAN_FUNCS()->blanks(s, end);
+}
+
+const char* _CrScan_StringBody(const char* s, const char* end, char quote)
+{
+	return SCAN_FUNCS()->string_body(s, end, quote);
+}
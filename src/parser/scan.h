@@ -0,0 +1,60 @@
+#pragma once
+
+#include <port.h>
+
+/*
+ * Tokenizer scanning helpers
+ *
+ * Each function skips a run of one class of characters in [s, end) and
+ * returns a pointer to the first character outside the class, or end.
+ * The tokenizer uses them to step over the bulk of identifiers, numbers,
+ * blanks and string bodies without a tokenizer_next() call per character.
+ * It still reads the character that ends the run itself, so line refills
+ * and error handling stay where they were.
+ *
+ * Besides the portable loops there are SSE2 and AVX2 versions that test
+ * 16 or 32 characters at a time. The best one the CPU supports is picked
+ * on the first call.
+ */
+
+const char* _CrScan_Identifier(const char* s, const char* end);
+const char* _CrScan_Digits(const char* s, const char* end);
+const char* _CrScan_Blanks(const char* s, const char* end);
+const char* _CrScan_StringBody(const char* s, const char* end, char quote);
+
+/* Most runs are empty or a single character, so the first one is tested
+   inline and the scan is only called for the rest */
+
+/* Letters, digits and '_'. Stops at non-ASCII bytes, the tokenizer
+   decides what to do with those. */
+static inline const char* CrScan_Identifier(const char* s, const char* end)
+{
+	if (s == end || !((*s >= 'a' && *s <= 'z') || (*s >= 'A' && *s <= 'Z') ||
+		(*s >= '0' && *s <= '9') || *s == '_'))
+		return s;
+	return _CrScan_Identifier(s + 1, end);
+}
+
+/* Decimal digits */
+static inline const char* CrScan_Digits(const char* s, const char* end)
+{
+	if (s == end || !(*s >= '0' && *s <= '9'))
+		return s;
+	return _CrScan_Digits(s + 1, end);
+}
+
+/* Spaces, tabs and form feeds */
+static inline const char* CrScan_Blanks(const char* s, const char* end)
+{
+	if (s == end || !(*s == ' ' || *s == '\t' || *s == '\014'))
+		return s;
+	return _CrScan_Blanks(s + 1, end);
+}
+
+/* Anything but 'quote', a backslash or a newline */
+static inline const char* CrScan_StringBody(const char* s, const char* end, char quote)
+{
+	if (s == end || *s == quote || *s == '\\' || *s == '\n')
+		return s;
+	return _CrScan_StringBody(s + 1, end, quote);
+}
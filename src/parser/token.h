@@ -86,20 +86,12 @@ enum token_type
 	TOK_NT_OFFSET = 256
 };
 
-typedef struct _memo
-{
-	int type;
-	void* node;
-	int mark;
-	struct _memo* next;
-} Memo;
-
 typedef struct _token
 {
 	token_type type;	// What the token is
-	CrObject* value;	// CrStringObject value of the token
+	Cr_size_t start;	// Offset of the token's text in the tokenizer buffer
+	Cr_size_t length;	// Length of the token's text
 	int lineno, col_offset, end_lineno, end_col_offset;	// Line and column position of the token
-	Memo* memo;
 } Token;
 
 token_type CrToken_OneChar(char c1);
@@ -1,4 +1,5 @@
 #include "tokenizer.h"
+#include "scan.h"
 
 #include <core/errorcode.h>
 #include <core/error.h>
@@ -36,11 +37,12 @@ static TokState* tokenizer_new()
 	tok->enc = NULL;
 	tok->encoding = NULL;
 	tok->cont_line = 0;
+	tok->line_start = NULL;
+	tok->multi_line_start = NULL;
 	tok->filename = NULL;
 	tok->decoding_readline = NULL;
 	tok->decoding_buffer = NULL;
 	tok->type_comments = 0;
-	tok->stdin_content = NULL;
 
 	return tok;
 }
@@ -60,24 +62,79 @@ static int syntaxerror(TokState* tok, const char* msg)
 	return TOK_ERRORTOKEN;
 }
 
-/* File pointer helpers */
+/* File helpers */
 
-// Get the next byte from tokenizer
-static int file_get_char(TokState* tok)
+// Turn "\r\n" and lone "\r" into "\n" in place, returns the new length
+static size_t translate_newlines_inplace(char* s, size_t len)
 {
-	return tok->fp->get();
+	char* out = s;
+	for (size_t i = 0; i < len; i++)
+	{
+		char c = s[i];
+		if (c == '\r')
+		{
+			c = '\n';
+			if (i + 1 < len && s[i + 1] == '\n')
+				i++;
+		}
+		*out++ = c;
+	}
+	return out - s;
 }
 
-// Peek at the next byte in tokenizer
-static int file_peek_char(TokState* tok)
+/* Read the rest of the file into a single buffer with one read where the
+   stream can tell its size, translate its newlines in place and make sure
+   it ends with one. The result is tokenized like a string, so no line is
+   ever copied again. */
+static char* file_read_all(TokState* tok, std::ifstream* fp)
 {
-	return tok->fp->peek();
-}
+	size_t size = 0, capacity = BUFSIZ;
 
-// Put back the last byte into tokenizer
-static void file_unget_char(TokState* tok)
-{
-	tok->fp->unget();
+	std::streampos pos = fp->tellg();
+	if (pos != std::streampos(-1) && fp->seekg(0, std::ios::end))
+	{
+		std::streamoff remaining = fp->tellg() - pos;
+		fp->seekg(pos);
+		if (remaining > 0)
+			capacity = (size_t)remaining;
+	}
+	else
+	{
+		fp->clear();
+	}
+
+	// Room for a final newline and the terminator
+	char* buf = (char*)Mem_Alloc(capacity + 2);
+	if (buf == NULL)
+	{
+		tok->done = E_NOMEM;
+		return NULL;
+	}
+
+	for (;;)
+	{
+		fp->read(buf + size, capacity - size);
+		size += (size_t)fp->gcount();
+		if (size < capacity || fp->peek() == EOF)
+			break;
+
+		// The stream couldn't tell its size or it grew, keep reading
+		capacity *= 2;
+		char* newbuf = (char*)Mem_Realloc(buf, capacity + 2);
+		if (newbuf == NULL)
+		{
+			Mem_Free(buf);
+			tok->done = E_NOMEM;
+			return NULL;
+		}
+		buf = newbuf;
+	}
+
+	size = translate_newlines_inplace(buf, size);
+	if (size == 0 || buf[size - 1] != '\n')
+		buf[size++] = '\n';
+	buf[size] = '\0';
+	return buf;
 }
 
 /* String helpers */
@@ -173,64 +230,54 @@ static char tokenizer_next(TokState* tok)
 					return EOF;
 				}
 			}
-			if (tok->start == NULL)
-				tok->buf = tok->cur;
 			tok->line_start = tok->cur;
 			tok->lineno++;
 			tok->inp = end;
 			return CR_CHARMASK(*tok->cur++);
 		}
-		if (tok->prompt != NULL)
+		/* Whole files are read up front and tokenized as a string, so a
+		   file pointer is only left for interactive input */
+		assert(tok->prompt != NULL);
+		if (tok->prompt == NULL)
 		{
-			char* newtok = CrSys_ReadLine(tok->prompt);
-			if (newtok != NULL)
-			{
-				char* translated = translate_newlines(newtok, 0, tok);
-				Mem_Free(newtok);
-				if (translated == NULL)
-					return EOF;
-				newtok = translated;
-				if (tok->stdin_content == NULL)
-				{
-					tok->stdin_content = (char*)Mem_Alloc(strlen(translated) + 1);
-					if (tok->stdin_content == NULL)
-					{
-						tok->done = E_NOMEM;
-						return EOF;
-					}
-					sprintf(tok->stdin_content, "%s", translated);
-				}
-				else
-				{
-					char* new_str = (char*)Mem_Alloc(strlen(tok->stdin_content) + strlen(translated) + 1);
-					if (new_str == NULL)
-					{
-						tok->done = E_NOMEM;
-						return EOF;
-					}
-					sprintf(new_str, "%s%s", tok->stdin_content, translated);
-					Mem_Free(tok->stdin_content);
-					tok->stdin_content = new_str;
-				}
-			}
-			if (tok->nextprompt != NULL)
-				tok->prompt = tok->nextprompt;
-			if (newtok == NULL)
-				tok->done = E_INTR;
-			else if (*newtok == '\0')
-			{
-				Mem_Free(newtok);
-				tok->done = E_EOF;
-			}
-			else if (tok->start != NULL)
+			tok->done = E_ERROR;
+			return EOF;
+		}
+		char* newtok = CrSys_ReadLine(tok->prompt);
+		if (newtok != NULL)
+		{
+			char* translated = translate_newlines(newtok, 0, tok);
+			Mem_Free(newtok);
+			if (translated == NULL)
+				return EOF;
+			newtok = translated;
+		}
+		if (tok->nextprompt != NULL)
+			tok->prompt = tok->nextprompt;
+		if (newtok == NULL)
+			tok->done = E_INTR;
+		else if (*newtok == '\0')
+		{
+			Mem_Free(newtok);
+			tok->done = E_EOF;
+		}
+		else
+		{
+			/* Append the line to the buffer rather than replacing it.
+			   Tokens refer to their text by offset into the buffer, so
+			   earlier lines have to stay put until parsing is done. */
+			size_t start = (tok->start != NULL) ? tok->start - tok->buf : 0;
+			size_t multi_line_start = (tok->multi_line_start != NULL) ? tok->multi_line_start - tok->buf : 0;
+			size_t oldlen = tok->cur - tok->buf;
+			size_t linelen = strlen(newtok);
+			size_t newlen = oldlen + linelen;
+			tok->lineno++;
+			if (newlen + 1 > (size_t)(tok->end - tok->buf))
 			{
-				size_t start = tok->start - tok->buf;
-				size_t oldlen = tok->cur - tok->buf;
-				size_t newlen = oldlen + strlen(newtok);
-				Cr_size_t cur_multi_line_start = tok->multi_line_start - tok->buf;
-				char* buf = tok->buf;
-				buf = (char*)Mem_Realloc(buf, newlen + 1);
-				tok->lineno++;
+				size_t newsize = 2 * (size_t)(tok->end - tok->buf);
+				if (newsize < newlen + 1)
+					newsize = newlen + 1;
+				char* buf = (char*)Mem_Realloc(tok->buf, newsize);
 				if (buf == NULL)
 				{
 					Mem_Free(tok->buf);
@@ -240,28 +287,18 @@ static char tokenizer_next(TokState* tok)
 					return EOF;
 				}
 				tok->buf = buf;
-				tok->cur = tok->buf + oldlen;
-				tok->multi_line_start = tok->buf + cur_multi_line_start;
-				tok->line_start = tok->cur;
-				strcpy(tok->buf + oldlen, newtok);
-				Mem_Free(newtok);
-				tok->inp = tok->buf + newlen;
-				tok->end = tok->inp + 1;
-				tok->start = tok->buf + start;
-			}
-			else
-			{
-				tok->lineno++;
-				if (tok->buf != NULL)
-					Mem_Free(tok->buf);
-				tok->buf = newtok;
-				tok->cur = tok->buf;
-				tok->line_start = tok->buf;
-				tok->inp = strchr(tok->buf, '\0');
-				tok->end = tok->inp + 1;
+				tok->end = tok->buf + newsize;
 			}
+			tok->cur = tok->buf + oldlen;
+			tok->line_start = tok->cur;
+			memcpy(tok->cur, newtok, linelen + 1);
+			Mem_Free(newtok);
+			tok->inp = tok->buf + newlen;
+			if (tok->start != NULL)
+				tok->start = tok->buf + start;
+			if (tok->multi_line_start != NULL)
+				tok->multi_line_start = tok->buf + multi_line_start;
 		}
-		///TODO: File pointer readline support
 	}
 }
 
@@ -287,6 +324,7 @@ static int decimal_tail(TokState* tok)
 	{
 		do
 		{
+			tok->cur = (char*)CrScan_Digits(tok->cur, tok->inp);
 			c = tokenizer_next(tok);
 		} while (isdigit(c));
 		if (c != '_')
@@ -465,6 +503,7 @@ again:
 	/* Skip spaces */
 	do
 	{
+		tok->cur = (char*)CrScan_Blanks(tok->cur, tok->inp);
 		c = tokenizer_next(tok);
 	} while (c == ' ' || c == '\t' || c == '\014');
 
@@ -478,6 +517,9 @@ again:
 
 		while (c != EOF && c != '\n')
 		{
+			// The comment runs to the end of the line
+			const char* nl = (const char*)memchr(tok->cur, '\n', tok->inp - tok->cur);
+			tok->cur = (nl != NULL) ? (char*)nl : tok->inp;
 			c = tokenizer_next(tok);
 		}
 
@@ -593,6 +635,7 @@ again:
 			{
 				nonascii = 1;
 			}
+			tok->cur = (char*)CrScan_Identifier(tok->cur, tok->inp);
 			c = tokenizer_next(tok);
 		}
 		tokenizer_back(tok, c);
@@ -965,6 +1008,10 @@ letter_quote:
 		/* Get rest of string */
 		while (end_quote_size != quote_size)
 		{
+			if (end_quote_size == 0)
+			{
+				tok->cur = (char*)CrScan_StringBody(tok->cur, tok->inp, (char)quote);
+			}
 			c = tokenizer_next(tok);
 			if (c == EOF)
 			{
@@ -1105,6 +1152,22 @@ TokState* CrTokenizer_FromFile(std::ifstream* fp, const char* ps1, const char* p
 {
 	TokState* tok = tokenizer_new(); if (tok == NULL)
 		return NULL;
+
+	// Without a prompt the whole file is read now and tokenized in place
+	if (ps1 == NULL)
+	{
+		char* input = file_read_all(tok, fp);
+		if (input == NULL)
+		{
+			CrTokenizer_Free(tok);
+			return NULL;
+		}
+		tok->input = input;
+		tok->buf = tok->cur = tok->inp = input;
+		tok->end = input;
+		return tok;
+	}
+
 	if ((tok->buf = (char*)Mem_Alloc(BUFSIZ)) == NULL)
 	{
 		CrTokenizer_Free(tok);
@@ -1141,7 +1204,5 @@ void CrTokenizer_Free(TokState* tok)
 		Mem_Free(tok->buf);
 	if (tok->input)
 		Mem_Free(tok->input);
-	if (tok->stdin_content)
-		Mem_Free(tok->stdin_content);
 	Mem_Free(tok);
 }
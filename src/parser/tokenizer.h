@@ -35,7 +35,7 @@ enum class decoding_state
 typedef struct tokstate
 {
     /* Input state; buf <= cur <= inp <= end */
-    /* NB an entire line is held in the buffer */
+    /* NB all input read so far is held in the buffer, tokens refer to it by offset */
     char* buf;                  // Input buffer, or NULL; malloc'ed if fp != NULL 
     char* cur;                  // Next character in buffer 
     char* inp;                  // End of data in buffer 
@@ -43,14 +43,13 @@ typedef struct tokstate
     const char* start;          // Start of current token if not NULL 
     int done;                   // E_OK normally, E_EOF at EOF, otherwise error code 
                                 // NB If done != E_OK, cur must be == inp!!! 
-    std::ifstream* fp;          // Rest of input; NULL if tokenizing a string 
+    std::ifstream* fp;          // Rest of interactive input; NULL if tokenizing a string or a whole file 
     int tabsize;                // Tab spacing 
     int indent;                 // Current indentation index 
     int indstack[MAX_INDENT];   // Stack of indents 
     int atbol;                  // Nonzero if at begin of new line 
     int pendin;                 // Pending indents (if > 0) or dedents (if < 0) 
     const char* prompt, * nextprompt;   // For interactive prompting 
-    char* stdin_content;
     int lineno;                 // Current line number 
     int first_lineno;           // First line of a single line or multi line string expression 
     int level;                  // () [] {} Parentheses nesting level; Used to allow free continuations inside them 
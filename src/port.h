@@ -78,6 +78,14 @@ bool ValueIsIn(First&& first, T && ... t)
 /* Check if pointer "p" is aligned to "a"-bytes boundary. */
 #define Cr_IS_ALIGNED(p, a) (!((uintptr_t)(p) & (uintptr_t)((a) - 1)))
 
+/* Address the current function will return to, i.e. its call site */
+#ifdef _MSC_VER
+#   include <intrin.h>
+#   define Cr_RETURN_ADDRESS() _ReturnAddress()
+#else
+#   define Cr_RETURN_ADDRESS() __builtin_return_address(0)
+#endif
+
 #ifndef CrAPI_FUNC
 #   define CrAPI_FUNC(RTYPE) RTYPE
 #endif